@@ -0,0 +1,226 @@
+#include "bufferpool.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+// Шаг, с которым Acquire проверяет отмену, пока ждёт возврата буфера.
+constexpr unsigned long kWaitSliceMs = 10;
+}
+
+BufferPool::Lease::Lease(Lease&& other) noexcept
+    : pool_(other.pool_), data_(other.data_), size_(other.size_),
+    numa_node_(other.numa_node_) {
+    other.pool_ = nullptr;
+    other.data_ = nullptr;
+    other.size_ = 0;
+}
+
+BufferPool::Lease& BufferPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        Release();
+        pool_ = other.pool_;
+        data_ = other.data_;
+        size_ = other.size_;
+        numa_node_ = other.numa_node_;
+        other.pool_ = nullptr;
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+    return *this;
+}
+
+BufferPool::Lease::~Lease() {
+    Release();
+}
+
+void BufferPool::Lease::Release() {
+    if (pool_ && data_) {
+        pool_->Return(data_, size_, numa_node_);
+    }
+    pool_ = nullptr;
+    data_ = nullptr;
+    size_ = 0;
+}
+
+BufferPool::BufferPool(qint64 budget_bytes)
+    : budget_bytes_(budget_bytes) {}
+
+BufferPool::~BufferPool() {
+    Trim();
+}
+
+void BufferPool::SetBudget(qint64 budget_bytes) {
+    QMutexLocker locker(&mutex_);
+    budget_bytes_ = budget_bytes;
+    if (current_bytes_ > budget_bytes_) {
+        FreeCachedLocked(current_bytes_ - budget_bytes_);
+    }
+    released_.wakeAll();
+}
+
+void BufferPool::SetUseHugePages(bool value) {
+    QMutexLocker locker(&mutex_);
+    use_huge_pages_ = value;
+}
+
+BufferPool::Lease BufferPool::Acquire(qint64 size_bytes, int numa_node,
+                                      const std::function<bool()>& is_cancelled) {
+    const qint64 size_class = SizeClassFor(size_bytes);
+    const FreeListKey key(numa_node, size_class);
+
+    QMutexLocker locker(&mutex_);
+    while (true) {
+        QVector<char*>& free_list = free_lists_[key];
+        if (!free_list.isEmpty()) {
+            char* data = free_list.takeLast();
+            in_use_bytes_ += size_class;
+            return Lease(this, data, size_class, numa_node);
+        }
+
+        const qint64 overflow = current_bytes_ + size_class - budget_bytes_;
+        if (overflow > 0) {
+            FreeCachedLocked(overflow);
+        }
+
+        // Запрос сверх бюджета разрешён, когда пул пуст, иначе воркер,
+        // которому нужен большой буфер, ждал бы вечно.
+        if (current_bytes_ + size_class <= budget_bytes_ ||
+            in_use_bytes_ == 0) {
+            char* data = AllocateAligned(size_class);
+            if (!data) {
+                return Lease();
+            }
+            current_bytes_ += size_class;
+            in_use_bytes_ += size_class;
+            peak_bytes_ = qMax(peak_bytes_, current_bytes_);
+            if (numa_node >= 0) {
+                locker.unlock();
+                std::memset(data, 0, static_cast<size_t>(size_class));
+            }
+            return Lease(this, data, size_class, numa_node);
+        }
+
+        if (!is_cancelled) {
+            released_.wait(&mutex_);
+            continue;
+        }
+        released_.wait(&mutex_, kWaitSliceMs);
+        if (is_cancelled()) {
+            return Lease();
+        }
+    }
+}
+
+void BufferPool::Trim() {
+    QMutexLocker locker(&mutex_);
+    FreeCachedLocked(current_bytes_);
+}
+
+qint64 BufferPool::budget_bytes() const {
+    QMutexLocker locker(&mutex_);
+    return budget_bytes_;
+}
+
+qint64 BufferPool::current_bytes() const {
+    QMutexLocker locker(&mutex_);
+    return current_bytes_;
+}
+
+qint64 BufferPool::in_use_bytes() const {
+    QMutexLocker locker(&mutex_);
+    return in_use_bytes_;
+}
+
+qint64 BufferPool::peak_bytes() const {
+    QMutexLocker locker(&mutex_);
+    return peak_bytes_;
+}
+
+qint64 BufferPool::SizeClassFor(qint64 size_bytes) const {
+    qint64 size_class = kPageSizeBytes;
+    while (size_class < size_bytes) {
+        size_class *= 2;
+    }
+    return size_class;
+}
+
+// Память берётся у ОС напрямую: куча может вернуть страницы, которые
+// уже разместил поток другого узла NUMA, и первое касание не сдвинет их.
+char* BufferPool::AllocateAligned(qint64 size_bytes) const {
+    const size_t size = static_cast<size_t>(size_bytes);
+#if defined(Q_OS_WIN)
+    return static_cast<char*>(
+        VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#else
+    const bool huge = use_huge_pages_ && size_bytes >= kHugePageSizeBytes;
+    // Для большой страницы начало должно быть выровнено по ней: берём
+    // с запасом и отдаём лишнее с краёв.
+    const size_t padding = huge ? static_cast<size_t>(kHugePageSizeBytes) : 0;
+    void* mapped = mmap(nullptr, size + padding, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) {
+        return nullptr;
+    }
+    char* data = static_cast<char*>(mapped);
+    if (padding > 0) {
+        const uintptr_t address = reinterpret_cast<uintptr_t>(mapped);
+        const size_t head = (padding - address % padding) % padding;
+        if (head > 0) {
+            munmap(mapped, head);
+        }
+        if (padding - head > 0) {
+            munmap(data + head + size, padding - head);
+        }
+        data += head;
+    }
+#if defined(Q_OS_LINUX) && defined(MADV_HUGEPAGE)
+    if (huge) {
+        madvise(data, size, MADV_HUGEPAGE);
+    }
+#endif
+    return data;
+#endif
+}
+
+void BufferPool::FreeAligned(char* data, qint64 size_bytes) {
+#if defined(Q_OS_WIN)
+    Q_UNUSED(size_bytes);
+    VirtualFree(data, 0, MEM_RELEASE);
+#else
+    munmap(data, static_cast<size_t>(size_bytes));
+#endif
+}
+
+bool BufferPool::FreeCachedLocked(qint64 needed_bytes) {
+    qint64 freed = 0;
+    for (auto it = free_lists_.begin();
+         it != free_lists_.end() && freed < needed_bytes; ++it) {
+        QVector<char*>& free_list = it.value();
+        while (!free_list.isEmpty() && freed < needed_bytes) {
+            const qint64 size_class = it.key().second;
+            FreeAligned(free_list.takeLast(), size_class);
+            current_bytes_ -= size_class;
+            freed += size_class;
+        }
+    }
+    return freed > 0;
+}
+
+void BufferPool::Return(char* data, qint64 size_bytes, int numa_node) {
+    QMutexLocker locker(&mutex_);
+    in_use_bytes_ -= size_bytes;
+    if (current_bytes_ > budget_bytes_) {
+        FreeAligned(data, size_bytes);
+        current_bytes_ -= size_bytes;
+    } else {
+        free_lists_[FreeListKey(numa_node, size_bytes)].append(data);
+    }
+    released_.wakeAll();
+}
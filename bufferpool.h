@@ -0,0 +1,88 @@
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QVector>
+#include <QWaitCondition>
+#include <QtGlobal>
+
+#include <functional>
+
+// Пул выровненных по странице буферов, общий для всех воркеров.
+// Суммарный объём выделенной памяти (занятой и закэшированной) не
+// превышает бюджет: при его исчерпании Acquire ждёт возврата буфера.
+class BufferPool {
+public:
+    static constexpr qint64 kDefaultBudgetBytes = 64 * 1024 * 1024;
+    static constexpr qint64 kPageSizeBytes = 4096;
+    static constexpr qint64 kHugePageSizeBytes = 2 * 1024 * 1024;
+
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease();
+
+        char* data() const { return data_; }
+        qint64 size() const { return size_; }
+        bool isNull() const { return data_ == nullptr; }
+        void Release();
+
+    private:
+        friend class BufferPool;
+        Lease(BufferPool* pool, char* data, qint64 size, int numa_node)
+            : pool_(pool), data_(data), size_(size), numa_node_(numa_node) {}
+
+        BufferPool* pool_ = nullptr;
+        char* data_ = nullptr;
+        qint64 size_ = 0;
+        int numa_node_ = -1;
+    };
+
+    explicit BufferPool(qint64 budget_bytes = kDefaultBudgetBytes);
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    void SetBudget(qint64 budget_bytes);
+    void SetUseHugePages(bool value);
+
+    // Возвращает буфер не меньше size_bytes; пустой Lease — при ошибке
+    // выделения памяти. Буферы с numa_node >= 0 кэшируются отдельно по
+    // узлам. Новые буферы — свежие страницы ОС, а не память кучи, которой
+    // уже касался поток другого узла; их заполняет вызывающий поток,
+    // чтобы страницы разместились на его узле. Ожидание свободного бюджета прерывается,
+    // когда is_cancelled вернёт true (тогда Lease тоже пустой).
+    Lease Acquire(qint64 size_bytes, int numa_node = -1,
+                  const std::function<bool()>& is_cancelled = nullptr);
+    void Trim();
+
+    qint64 budget_bytes() const;
+    qint64 current_bytes() const;
+    qint64 in_use_bytes() const;
+    qint64 peak_bytes() const;
+
+private:
+    qint64 SizeClassFor(qint64 size_bytes) const;
+    char* AllocateAligned(qint64 size_bytes) const;
+    static void FreeAligned(char* data, qint64 size_bytes);
+    bool FreeCachedLocked(qint64 needed_bytes);
+    void Return(char* data, qint64 size_bytes, int numa_node);
+
+    // Ключ — (узел NUMA, класс размера).
+    using FreeListKey = QPair<int, qint64>;
+
+    mutable QMutex mutex_;
+    QWaitCondition released_;
+    QHash<FreeListKey, QVector<char*>> free_lists_;
+    qint64 budget_bytes_;
+    qint64 current_bytes_ = 0;
+    qint64 in_use_bytes_ = 0;
+    qint64 peak_bytes_ = 0;
+    bool use_huge_pages_ = false;
+};
@@ -0,0 +1,141 @@
+#include "cpuaffinity.h"
+
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QThread>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#elif defined(Q_OS_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+QVector<int> CpuAffinity::ParseCpuList(const QString& list) {
+    QVector<int> cpus;
+    const QStringList parts = list.split(',', Qt::SkipEmptyParts);
+    for (const QString& raw_part : parts) {
+        const QString part = raw_part.trimmed();
+        const int dash = part.indexOf('-');
+        bool ok_first = false;
+        bool ok_last = false;
+        int first = 0;
+        int last = 0;
+        if (dash < 0) {
+            first = last = part.toInt(&ok_first);
+            ok_last = ok_first;
+        } else {
+            first = part.left(dash).trimmed().toInt(&ok_first);
+            last = part.mid(dash + 1).trimmed().toInt(&ok_last);
+        }
+        if (!ok_first || !ok_last || first < 0 || last < first) {
+            return {};
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            if (!cpus.contains(cpu)) {
+                cpus.append(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+QVector<int> CpuAffinity::AllCpus() {
+    QVector<int> cpus;
+#if defined(Q_OS_LINUX)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.append(cpu);
+            }
+        }
+        if (!cpus.isEmpty()) {
+            return cpus;
+        }
+    }
+#elif defined(Q_OS_WIN)
+    DWORD_PTR process_mask = 0;
+    DWORD_PTR system_mask = 0;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) {
+        for (int cpu = 0; cpu < static_cast<int>(sizeof(DWORD_PTR) * 8); ++cpu) {
+            if (process_mask & (DWORD_PTR(1) << cpu)) {
+                cpus.append(cpu);
+            }
+        }
+        if (!cpus.isEmpty()) {
+            return cpus;
+        }
+    }
+#endif
+    const int count = QThread::idealThreadCount();
+    for (int cpu = 0; cpu < count; ++cpu) {
+        cpus.append(cpu);
+    }
+    return cpus;
+}
+
+bool CpuAffinity::PinCurrentThread(const QVector<int>& cpus) {
+    if (cpus.isEmpty()) {
+        return false;
+    }
+#if defined(Q_OS_LINUX)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(Q_OS_WIN)
+    DWORD_PTR mask = 0;
+    for (int cpu : cpus) {
+        if (cpu < static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+            mask |= DWORD_PTR(1) << cpu;
+        }
+    }
+    return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+    return false;
+#endif
+}
+
+int CpuAffinity::NumaNodeOfCpus(const QVector<int>& cpus) {
+#if defined(Q_OS_LINUX)
+    if (cpus.isEmpty()) {
+        return -1;
+    }
+    const QDir nodes_dir("/sys/devices/system/node");
+    const QStringList nodes =
+        nodes_dir.entryList({"node*"}, QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString& node_name : nodes) {
+        bool ok = false;
+        const int node = node_name.mid(4).toInt(&ok);
+        if (!ok) {
+            continue;
+        }
+        QFile cpulist_file(nodes_dir.filePath(node_name + "/cpulist"));
+        if (!cpulist_file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        const QVector<int> node_cpus =
+            ParseCpuList(QString::fromLatin1(cpulist_file.readAll()));
+        bool all_local = true;
+        for (int cpu : cpus) {
+            if (!node_cpus.contains(cpu)) {
+                all_local = false;
+                break;
+            }
+        }
+        if (all_local) {
+            return node;
+        }
+    }
+#else
+    Q_UNUSED(cpus);
+#endif
+    return -1;
+}
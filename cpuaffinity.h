@@ -0,0 +1,19 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+class CpuAffinity {
+public:
+    // Разбирает список вида "0-3,8,10-11"; при ошибке возвращает пустой список.
+    static QVector<int> ParseCpuList(const QString& list);
+    // Процессоры, доступные процессу (с учётом cpuset и taskset); если
+    // маску узнать нельзя — 0..idealThreadCount-1.
+    static QVector<int> AllCpus();
+
+    static bool PinCurrentThread(const QVector<int>& cpus);
+
+    // Узел NUMA, к которому относятся все cpus, или -1, если узлов
+    // несколько либо топология неизвестна.
+    static int NumaNodeOfCpus(const QVector<int>& cpus);
+};
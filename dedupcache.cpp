@@ -0,0 +1,185 @@
+#include "dedupcache.h"
+
+#include "iothrottle.h"
+
+#include <QFile>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+#if defined(Q_OS_LINUX)
+#include <linux/fs.h>
+#endif
+
+namespace {
+
+constexpr int kFingerprintChunkBytes = 1024 * 1024;
+
+bool CreateHardLink(const QString& source_path, const QString& target_path) {
+#if defined(Q_OS_WIN)
+    return CreateHardLinkW(reinterpret_cast<LPCWSTR>(target_path.utf16()),
+                           reinterpret_cast<LPCWSTR>(source_path.utf16()),
+                           nullptr) != 0;
+#else
+    return ::link(QFile::encodeName(source_path).constData(),
+                  QFile::encodeName(target_path).constData()) == 0;
+#endif
+}
+
+bool CloneFile(const QString& source_path, const QString& target_path) {
+#if defined(Q_OS_LINUX) && defined(FICLONE)
+    const int source_fd =
+        ::open(QFile::encodeName(source_path).constData(), O_RDONLY | O_CLOEXEC);
+    if (source_fd < 0) {
+        return false;
+    }
+    const int target_fd =
+        ::open(QFile::encodeName(target_path).constData(),
+               O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (target_fd < 0) {
+        ::close(source_fd);
+        return false;
+    }
+    const bool ok = ::ioctl(target_fd, FICLONE, source_fd) == 0;
+    ::close(target_fd);
+    ::close(source_fd);
+    if (!ok) {
+        QFile::remove(target_path);
+    }
+    return ok;
+#else
+    Q_UNUSED(source_path);
+    Q_UNUSED(target_path);
+    return false;
+#endif
+}
+
+}  // namespace
+
+DedupCache::DedupCache(int capacity)
+    : capacity_(capacity) {}
+
+bool DedupCache::HasSize(qint64 size_bytes) const {
+    QMutexLocker locker(&mutex_);
+    return size_counts_.contains(size_bytes);
+}
+
+QString DedupCache::Find(qint64 size_bytes, const QByteArray& fingerprint,
+                         qint64* output_size_bytes) const {
+    QMutexLocker locker(&mutex_);
+    const Output output = outputs_.value(KeyFor(size_bytes, fingerprint));
+    if (output_size_bytes) {
+        *output_size_bytes = output.size_bytes;
+    }
+    return output.path;
+}
+
+void DedupCache::Insert(qint64 size_bytes, const QByteArray& fingerprint,
+                        const QString& output_path, qint64 output_size_bytes) {
+    const QByteArray key = KeyFor(size_bytes, fingerprint);
+    const Output output{output_path, output_size_bytes};
+
+    QMutexLocker locker(&mutex_);
+    if (outputs_.contains(key)) {
+        outputs_[key] = output;
+        return;
+    }
+    outputs_.insert(key, output);
+    size_counts_[size_bytes] += 1;
+    insertion_order_.enqueue(key);
+
+    while (insertion_order_.size() > capacity_) {
+        RemoveLocked(insertion_order_.dequeue());
+    }
+}
+
+void DedupCache::Remove(qint64 size_bytes, const QByteArray& fingerprint) {
+    const QByteArray key = KeyFor(size_bytes, fingerprint);
+
+    QMutexLocker locker(&mutex_);
+    RemoveLocked(key);
+    insertion_order_.removeOne(key);
+}
+
+void DedupCache::Clear() {
+    QMutexLocker locker(&mutex_);
+    outputs_.clear();
+    size_counts_.clear();
+    insertion_order_.clear();
+}
+
+QByteArray DedupCache::Fingerprint(const QString& path,
+                                   IoThrottle* io_throttle,
+                                   const std::function<bool()>& is_cancelled) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+    QCryptographicHash hash(kHashAlgorithm);
+    QByteArray chunk(kFingerprintChunkBytes, Qt::Uninitialized);
+    while (true) {
+        if (is_cancelled && is_cancelled()) {
+            return {};
+        }
+        const qint64 expected_size = qMin<qint64>(chunk.size(), file.size() - file.pos());
+        if (io_throttle && expected_size > 0 &&
+            !io_throttle->AcquireRead(expected_size, is_cancelled)) {
+            return {};
+        }
+        const qint64 read_size = file.read(chunk.data(), chunk.size());
+        if (read_size < 0) {
+            return {};
+        }
+        if (read_size == 0) {
+            break;
+        }
+        hash.addData(QByteArray::fromRawData(chunk.constData(), static_cast<int>(read_size)));
+    }
+    return hash.result();
+}
+
+bool DedupCache::Materialize(const QString& source_path,
+                             const QString& target_path,
+                             Settings::DedupMode mode,
+                             bool copy_fallback) {
+    if (QFile::exists(target_path)) {
+        QFile::remove(target_path);
+    }
+
+    bool ok = false;
+    switch (mode) {
+    case Settings::DedupMode::kHardLink:
+        ok = CreateHardLink(source_path, target_path);
+        break;
+    case Settings::DedupMode::kReflink:
+        ok = CloneFile(source_path, target_path);
+        break;
+    case Settings::DedupMode::kOff:
+        break;
+    }
+
+    if (!ok && copy_fallback) {
+        ok = QFile::copy(source_path, target_path);
+    }
+    return ok;
+}
+
+QByteArray DedupCache::KeyFor(qint64 size_bytes,
+                              const QByteArray& fingerprint) {
+    return QByteArray::number(size_bytes) + ':' + fingerprint;
+}
+
+void DedupCache::RemoveLocked(const QByteArray& key) {
+    if (outputs_.remove(key) == 0) {
+        return;
+    }
+    const qint64 size_bytes = key.left(key.indexOf(':')).toLongLong();
+    auto it = size_counts_.find(size_bytes);
+    if (it != size_counts_.end() && --it.value() <= 0) {
+        size_counts_.erase(it);
+    }
+}
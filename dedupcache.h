@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QHash>
+#include <QMutex>
+#include <QQueue>
+#include <QString>
+#include <QtGlobal>
+
+#include <functional>
+
+#include "settings.h"
+
+class IoThrottle;
+
+// Кэш недавно записанных выходов, общий для воркеров: (размер, отпечаток
+// входа) -> выходной файл и его размер. Отпечаток считается только при
+// совпадении размера с уже известным входом. Размер выхода хранится
+// отдельно: при сжатии он не совпадает с размером входа.
+class DedupCache {
+public:
+    static constexpr int kDefaultCapacity = 4096;
+    // Совпадение отпечатков — единственное основание связать выходы, а
+    // входы может подобрать посторонний, поэтому хеш стойкий к коллизиям.
+    static constexpr QCryptographicHash::Algorithm kHashAlgorithm =
+        QCryptographicHash::Sha256;
+
+    explicit DedupCache(int capacity = kDefaultCapacity);
+
+    bool HasSize(qint64 size_bytes) const;
+    // output_size_bytes, если задан, получает размер выхода на момент
+    // записи; по нему проверяется, что выход с тех пор не изменился.
+    QString Find(qint64 size_bytes, const QByteArray& fingerprint,
+                 qint64* output_size_bytes = nullptr) const;
+    void Insert(qint64 size_bytes, const QByteArray& fingerprint,
+                const QString& output_path, qint64 output_size_bytes);
+    void Remove(qint64 size_bytes, const QByteArray& fingerprint);
+    void Clear();
+
+    // Пустой результат — если файл не удалось прочитать или чтение
+    // прервано через is_cancelled. Чтение списывается с io_throttle,
+    // если он задан.
+    static QByteArray Fingerprint(const QString& path,
+                                  IoThrottle* io_throttle = nullptr,
+                                  const std::function<bool()>& is_cancelled = nullptr);
+
+    // Создаёт target из source жёсткой ссылкой или reflink (FICLONE),
+    // при неудаче и copy_fallback — обычным копированием.
+    static bool Materialize(const QString& source_path,
+                            const QString& target_path,
+                            Settings::DedupMode mode,
+                            bool copy_fallback);
+
+private:
+    static QByteArray KeyFor(qint64 size_bytes, const QByteArray& fingerprint);
+    void RemoveLocked(const QByteArray& key);
+
+    mutable QMutex mutex_;
+    int capacity_;
+    struct Output {
+        QString path;
+        qint64 size_bytes = 0;
+    };
+
+    QHash<QByteArray, Output> outputs_;
+    QHash<qint64, int> size_counts_;
+    QQueue<QByteArray> insertion_order_;
+};
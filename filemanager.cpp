@@ -1,7 +1,13 @@
 #include "filemanager.h"
 
+#include "tracing.h"
+
 #include <QDir>
 #include <QFileInfo>
+#include <QSet>
+#include <QStorageInfo>
+
+#include <algorithm>
 
 
 FileManager::FileManager(QObject* parent)
@@ -46,6 +52,7 @@ bool FileManager::IsValid() const {
 }
 
 const QStringList FileManager::GetInputFiles() {
+    TRACE_SCOPE("GetInputFiles");
     if (!IsValid()) {
         emit ErrorOccurred(
             "Невозможно получить список файлов: параметры не заданы");
@@ -71,6 +78,7 @@ const QStringList FileManager::GetInputFiles() {
 QString FileManager::GetOutputPathFor(const QString& input_file_path,
                                       const QString& output_directory,
                                       OutputPathMode path_mode) const {
+    TRACE_SCOPE("GetOutputPathFor");
     QFileInfo input_info(input_file_path);
     QString base_name = input_info.fileName();
     QString out_path = output_directory + QDir::separator() + base_name;
@@ -95,6 +103,55 @@ QString FileManager::GetOutputPathFor(const QString& input_file_path,
     }
 }
 
+QStringList FileManager::GetOutputPathsFor(const QStringList& input_file_paths,
+                                           const QString& output_directory,
+                                           OutputPathMode path_mode) const {
+    TRACE_SCOPE("GetOutputPathsFor");
+    QStringList out_paths;
+    out_paths.reserve(input_file_paths.size());
+    if (path_mode != OutputPathMode::kAppendCounter) {
+        for (const QString& input_file_path : input_file_paths) {
+            out_paths.append(GetOutputPathFor(input_file_path, output_directory, path_mode));
+        }
+        return out_paths;
+    }
+
+    // На Windows и macOS файловые системы обычно не различают регистр:
+    // занятое "A_1" не должно уступить место "a_1".
+    auto name_key = [](const QString& name) {
+#if defined(Q_OS_WIN) || defined(Q_OS_MACOS)
+        return name.toCaseFolded();
+#else
+        return name;
+#endif
+    };
+
+    const QDir out_dir(output_directory);
+    QSet<QString> taken;
+    const QStringList existing = out_dir.entryList(
+        QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+    for (const QString& name : existing) {
+        taken.insert(name_key(name));
+    }
+
+    for (const QString& input_file_path : input_file_paths) {
+        const QFileInfo input_info(input_file_path);
+        const QString name = input_info.completeBaseName();
+        const QString suffix = input_info.suffix();
+        for (int counter = 1;; ++counter) {
+            const QString candidate = suffix.isEmpty()
+                ? QString("%1_%2").arg(name).arg(counter)
+                : QString("%1_%2.%3").arg(name).arg(counter).arg(suffix);
+            if (!taken.contains(name_key(candidate))) {
+                taken.insert(name_key(candidate));
+                out_paths.append(out_dir.absoluteFilePath(candidate));
+                break;
+            }
+        }
+    }
+    return out_paths;
+}
+
 bool FileManager::DirectoryExists(const QString& path) const {
     QFileInfo info(path);
     return info.exists() && info.isDir();
@@ -104,3 +161,55 @@ bool FileManager::MaskIsValid(const QString& mask) const {
     if (mask.trimmed().isEmpty()) return false;
     return mask.contains('*') || mask.contains('.');
 }
+
+FileManager::RunPlan FileManager::PlanRun(const Settings& settings, double bytes_per_sec) {
+    TRACE_SCOPE("PlanRun");
+    RunPlan plan;
+    plan.files = GetInputFiles();
+    plan.sizes.reserve(plan.files.size());
+    qint64 largest_window_bytes = 0;
+    // Входы удаляются после сброса выходов: при групповой фиксации на диске
+    // одновременно лежат выходы целой группы.
+    const int window_files =
+        settings.durability() == Settings::Durability::kGroupCommit
+            ? qMax(1, settings.group_commit_max_files())
+            : 1;
+    qint64 window_bytes = 0;
+    for (int i = 0; i < plan.files.size(); ++i) {
+        const qint64 size = QFileInfo(plan.files.at(i)).size();
+        plan.sizes.append(size);
+        plan.total_bytes += size;
+        window_bytes += size;
+        if (i >= window_files) {
+            window_bytes -= plan.sizes.at(i - window_files);
+        }
+        largest_window_bytes = qMax(largest_window_bytes, window_bytes);
+    }
+
+    const QStorageInfo output_storage(settings.output_directory());
+    if (output_storage.isValid()) {
+        plan.available_disk_bytes = output_storage.bytesAvailable();
+    }
+    // Выход занимает столько же, сколько вход. Место входа освобождается
+    // сразу, только если входы удаляются по одному и лежат на том же диске;
+    // контейнер удаляет входы лишь в конце.
+    const bool frees_as_it_goes =
+        settings.delete_input_files() &&
+        settings.output_format() == Settings::OutputFormat::kFiles &&
+        output_storage.isValid() &&
+        QStorageInfo(input_directory_).rootPath() == output_storage.rootPath();
+    plan.peak_disk_bytes = frees_as_it_goes ? largest_window_bytes : plan.total_bytes;
+
+    double rate = bytes_per_sec;
+    const Settings::IoLimits& limits = settings.io_limits();
+    for (qint64 limit : {limits.read_bytes_per_sec, limits.write_bytes_per_sec}) {
+        if (limit > 0) {
+            rate = rate > 0 ? std::min(rate, static_cast<double>(limit))
+                            : static_cast<double>(limit);
+        }
+    }
+    if (rate > 0) {
+        plan.estimated_duration_ms = static_cast<qint64>(plan.total_bytes * 1000.0 / rate);
+    }
+    return plan;
+}
@@ -3,6 +3,9 @@
 #include <QObject>
 #include <QString>
 #include <QStringList>
+#include <QVector>
+
+#include "settings.h"
 
 class FileManager : public QObject {
     Q_OBJECT
@@ -26,6 +29,29 @@ public:
     QString GetOutputPathFor(const QString& input_file_path,
                              const QString& output_directory,
                              OutputPathMode path_mode) const;
+    // То же для всего пакета: в режиме kAppendCounter выходная папка
+    // читается один раз, а не проверяется по кандидату на файл. Имена,
+    // выданные раньше в пакете, считаются занятыми.
+    QStringList GetOutputPathsFor(const QStringList& input_file_paths,
+                                  const QString& output_directory,
+                                  OutputPathMode path_mode) const;
+
+    // Что сделает запуск с settings, не трогая файлов.
+    struct RunPlan {
+        QStringList files;
+        QVector<qint64> sizes;
+        qint64 total_bytes = 0;
+        // Наибольший объём, который займут выходы и ещё не удалённые входы
+        // сверх уже занятого; без учёта дедупликации.
+        qint64 peak_disk_bytes = 0;
+        // Свободно в выходной папке; -1, если узнать не удалось.
+        qint64 available_disk_bytes = -1;
+        // -1, если скорость неизвестна.
+        qint64 estimated_duration_ms = -1;
+    };
+    // bytes_per_sec — измеренная скорость обработки (0 — неизвестна);
+    // оценка времени учитывает и лимиты ввода-вывода из settings.
+    RunPlan PlanRun(const Settings& settings, double bytes_per_sec);
 
 signals:
     void ErrorOccurred(const QString& message);
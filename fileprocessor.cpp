@@ -1,17 +1,147 @@
 #include "fileprocessor.h"
 
+#include "iothrottle.h"
+#include "packedcontainer.h"
+#include "tracing.h"
+
 #include <QFile>
+#include <QThread>
+
+namespace {
+// Чанк читается и пишется частями, между которыми проверяется отмена:
+// на медленном диске чанк целиком может занимать сотни миллисекунд.
+constexpr qint64 kCancelCheckBytes = 256 * 1024;
+
+// Возвращает число прочитанных байт (меньше size только в конце файла)
+// или -1 при ошибке и отмене.
+qint64 ReadChunk(QFile& file, char* data, qint64 size,
+                 const std::function<bool()>& is_cancelled) {
+    qint64 total = 0;
+    while (total < size) {
+        if (total > 0 && is_cancelled && is_cancelled()) {
+            return -1;
+        }
+        const qint64 read_size = file.read(data + total, qMin(kCancelCheckBytes, size - total));
+        if (read_size < 0) {
+            return -1;
+        }
+        if (read_size == 0) {
+            break;
+        }
+        total += read_size;
+    }
+    return total;
+}
+
+// Сколько байт ожидается от следующего ReadChunk: квота лимита чтения
+// берётся до чтения, а не после него.
+qint64 NextReadSize(qint64 total_size, qint64 read_total) {
+    const qint64 remaining = total_size - read_total;
+    // Файл мог вырасти после size(); тогда квота — полный чанк.
+    return remaining > 0 ? qMin(FileProcessor::kChunkSizeBytes, remaining)
+                         : FileProcessor::kChunkSizeBytes;
+}
+
+// Существующий выход удаляется, а не усекается: он может быть жёсткой
+// ссылкой на другой выход (дедупликация прошлых запусков), и запись на
+// месте изменила бы оба файла.
+bool OpenFreshOutput(QFile& file, QIODevice::OpenMode mode) {
+    if (file.exists() && !file.remove()) {
+        return false;
+    }
+    return file.open(mode);
+}
+
+bool WriteChunk(QFile& file, const char* data, qint64 size,
+                const std::function<bool()>& is_cancelled) {
+    qint64 total = 0;
+    while (total < size) {
+        if (total > 0 && is_cancelled && is_cancelled()) {
+            return false;
+        }
+        const qint64 part = qMin(kCancelCheckBytes, size - total);
+        if (file.write(data + total, part) != part) {
+            return false;
+        }
+        total += part;
+    }
+    return true;
+}
+}  // namespace
 
-void FileProcessor::XorChunk(QByteArray& chunk, const QByteArray& key) {
+void FileProcessor::XorChunk(char* data, qint64 size, const QByteArray& key,
+                             qint64 key_phase) {
     if (key.size() != 8) return;
     const char* k = key.constData();
     const int key_len = 8;
-    char* data = chunk.data();
-    const int size = chunk.size();
-    for (int i = 0; i < size; ++i) {
+    for (qint64 i = 0; i < size; ++i) {
         data[i] = static_cast<char>(static_cast<uchar>(data[i]) ^
-                                    static_cast<uchar>(k[i % key_len]));
+                                    static_cast<uchar>(k[(key_phase + i) % key_len]));
+    }
+}
+
+FileProcessor::FileProcessor(BufferPool* buffer_pool)
+    : own_buffer_pool_(buffer_pool ? nullptr : std::make_unique<BufferPool>()),
+    buffer_pool_(buffer_pool ? buffer_pool : own_buffer_pool_.get()) {}
+
+FileProcessor::SmallFileResult FileProcessor::ProcessSmallFile(
+    const QString& input_path,
+    const QString& output_path,
+    const QByteArray& xor_key_8_bytes,
+    qint64 max_size_bytes,
+    std::function<bool()> is_cancelled) {
+    TRACE_SCOPE("ProcessSmallFile");
+    if (xor_key_8_bytes.size() != 8) {
+        return SmallFileResult::kFailed;
+    }
+
+    QFile in_file(input_path);
+    if (!in_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        return SmallFileResult::kFailed;
+    }
+
+    const qint64 size = in_file.size();
+    if (size > max_size_bytes) {
+        return SmallFileResult::kTooLarge;
+    }
+
+    // Читаем на байт больше, чтобы заметить файл, выросший после size().
+    BufferPool::Lease buffer = buffer_pool_->Acquire(size + 1, numa_node_, is_cancelled);
+    if (buffer.isNull()) {
+        return SmallFileResult::kFailed;
+    }
+    if (io_throttle_ && !io_throttle_->AcquireRead(size, is_cancelled)) {
+        return SmallFileResult::kFailed;
+    }
+    char* data = buffer.data();
+    const qint64 read_size = in_file.read(data, size + 1);
+    in_file.close();
+    if (read_size < 0) {
+        return SmallFileResult::kFailed;
+    }
+    if (read_size > size) {
+        return SmallFileResult::kTooLarge;
+    }
+    if (input_hash_) {
+        input_hash_->addData(QByteArray::fromRawData(data, static_cast<int>(read_size)));
+    }
+
+    XorChunk(data, read_size, xor_key_8_bytes, 0);
+
+    if (io_throttle_ && !io_throttle_->AcquireWrite(read_size, is_cancelled)) {
+        return SmallFileResult::kFailed;
+    }
+    QFile out_file(output_path);
+    if (!OpenFreshOutput(out_file, QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+        return SmallFileResult::kFailed;
     }
+    if (read_size > 0 && out_file.write(data, read_size) != read_size) {
+        out_file.close();
+        QFile::remove(output_path);
+        return SmallFileResult::kFailed;
+    }
+    out_file.close();
+    return SmallFileResult::kDone;
 }
 
 bool FileProcessor::ProcessFile(
@@ -20,6 +150,7 @@ bool FileProcessor::ProcessFile(
     const QByteArray& xor_key_8_bytes,
     std::function<void(int percent)> progress_callback,
     std::function<bool()> is_cancelled) {
+    TRACE_SCOPE("ProcessFile");
     if (xor_key_8_bytes.size() != 8) {
         return false;
     }
@@ -30,10 +161,23 @@ bool FileProcessor::ProcessFile(
     }
 
     QFile out_file(output_path);
-    if (!out_file.open(QIODevice::WriteOnly)) {
+    if (!OpenFreshOutput(out_file, QIODevice::WriteOnly)) {
+        in_file.close();
+        return false;
+    }
+
+    auto discard_output = [&in_file, &out_file, &output_path]() {
+        out_file.close();
         in_file.close();
+        QFile::remove(output_path);
         return false;
+    };
+
+    BufferPool::Lease buffer = buffer_pool_->Acquire(kChunkSizeBytes, numa_node_, is_cancelled);
+    if (buffer.isNull()) {
+        return discard_output();
     }
+    char* chunk = buffer.data();
 
     const qint64 total_size = in_file.size();
     qint64 read_total = 0;
@@ -41,33 +185,207 @@ bool FileProcessor::ProcessFile(
 
     while (!in_file.atEnd()) {
         if (is_cancelled && is_cancelled()) {
-            out_file.close();
-            in_file.close();
-            QFile::remove(output_path);
-            return false;
+            return discard_output();
         }
 
-        QByteArray chunk = in_file.read(kChunkSizeBytes);
-        if (chunk.isEmpty() && !in_file.atEnd()) {
-            out_file.close();
-            in_file.close();
-            QFile::remove(output_path);
-            return false;
+        if (io_throttle_ &&
+            !io_throttle_->AcquireRead(NextReadSize(total_size, read_total), is_cancelled)) {
+            return discard_output();
         }
-        if (chunk.isEmpty()) {
+        qint64 chunk_size = 0;
+        {
+            TRACE_SCOPE("ProcessFile.read");
+            chunk_size = ReadChunk(in_file, chunk, kChunkSizeBytes, is_cancelled);
+        }
+        if (chunk_size < 0 || (chunk_size == 0 && !in_file.atEnd())) {
+            return discard_output();
+        }
+        if (chunk_size == 0) {
             break;
         }
 
-        XorChunk(chunk, xor_key_8_bytes);
+        if (input_hash_) {
+            input_hash_->addData(QByteArray::fromRawData(chunk, static_cast<int>(chunk_size)));
+        }
+        {
+            TRACE_SCOPE("ProcessFile.xor");
+            XorChunk(chunk, chunk_size, xor_key_8_bytes, read_total);
+        }
+
+        if (io_throttle_ &&
+            !io_throttle_->AcquireWrite(chunk_size, is_cancelled)) {
+            return discard_output();
+        }
+        {
+            TRACE_SCOPE("ProcessFile.write");
+            if (!WriteChunk(out_file, chunk, chunk_size, is_cancelled)) {
+                return discard_output();
+            }
+        }
+
+        read_total += chunk_size;
+        if (progress_callback && total_size > 0) {
+            int percent = static_cast<int>((100 * read_total) / total_size);
+            if (percent != last_percent) {
+                last_percent = percent;
+                progress_callback(percent);
+            }
+        }
+    }
+
+    out_file.close();
+    in_file.close();
+    if (progress_callback) {
+        progress_callback(100);
+    }
+    return true;
+}
+
+bool FileProcessor::CompressFile(
+    const QString& input_path,
+    const QString& output_path,
+    const QByteArray& xor_key_8_bytes,
+    StreamCodec::Codec codec,
+    std::function<void(int percent)> progress_callback,
+    std::function<bool()> is_cancelled) {
+    TRACE_SCOPE("CompressFile");
+    return ProcessFileWithCodec(input_path, output_path, xor_key_8_bytes, codec, true,
+                                progress_callback, is_cancelled, nullptr);
+}
+
+bool FileProcessor::DecompressFile(
+    const QString& input_path,
+    const QString& output_path,
+    const QByteArray& xor_key_8_bytes,
+    std::function<void(int percent)> progress_callback,
+    std::function<bool()> is_cancelled,
+    bool* not_compressed) {
+    TRACE_SCOPE("DecompressFile");
+    return ProcessFileWithCodec(input_path, output_path, xor_key_8_bytes,
+                                StreamCodec::Codec::kNone, false,
+                                progress_callback, is_cancelled, not_compressed);
+}
+
+bool FileProcessor::ProcessFileWithCodec(
+    const QString& input_path,
+    const QString& output_path,
+    const QByteArray& xor_key_8_bytes,
+    StreamCodec::Codec codec,
+    bool compress,
+    const std::function<void(int percent)>& progress_callback,
+    const std::function<bool()>& is_cancelled,
+    bool* not_compressed) {
+    if (not_compressed) {
+        *not_compressed = false;
+    }
+    if (xor_key_8_bytes.size() != 8) {
+        return false;
+    }
+
+    QFile in_file(input_path);
+    if (!in_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QFile out_file(output_path);
+    if (!OpenFreshOutput(out_file, QIODevice::WriteOnly)) {
+        in_file.close();
+        return false;
+    }
+
+    auto discard_output = [&in_file, &out_file, &output_path]() {
+        out_file.close();
+        in_file.close();
+        QFile::remove(output_path);
+        return false;
+    };
+
+    BufferPool::Lease buffer = buffer_pool_->Acquire(kChunkSizeBytes, numa_node_, is_cancelled);
+    if (buffer.isNull()) {
+        return discard_output();
+    }
+    char* chunk = buffer.data();
+
+    const qint64 total_size = in_file.size();
+    StreamCodec stream_codec;
+    if (compress) {
+        const int threads = total_size < kMultiThreadCodecBytes ? 1
+            : codec_threads_ > 0                              ? codec_threads_
+                                                              : QThread::idealThreadCount();
+        if (!stream_codec.BeginCompress(codec, threads)) {
+            return discard_output();
+        }
+    }
+
+    // coded — выход кодека; при распаковке его размер не связан с
+    // размером чанка, поэтому фаза ключа считается по записанному.
+    QByteArray coded;
+    qint64 read_total = 0;
+    qint64 written_total = 0;
+    int last_percent = -1;
 
-        if (out_file.write(chunk) != chunk.size()) {
-            out_file.close();
-            in_file.close();
-            QFile::remove(output_path);
+    // Пишет и опустошает coded; распакованные данные перед записью
+    // проходят XOR.
+    std::function<bool()> write_coded = [&]() {
+        if (coded.isEmpty()) {
+            return true;
+        }
+        if (!compress) {
+            XorChunk(coded.data(), coded.size(), xor_key_8_bytes, written_total);
+        }
+        if (io_throttle_ &&
+            !io_throttle_->AcquireWrite(coded.size(), is_cancelled)) {
+            return false;
+        }
+        TRACE_SCOPE("ProcessFileWithCodec.write");
+        if (!WriteChunk(out_file, coded.constData(), coded.size(), is_cancelled)) {
             return false;
         }
+        written_total += coded.size();
+        coded.resize(0);
+        return true;
+    };
+
+    while (!in_file.atEnd()) {
+        if (is_cancelled && is_cancelled()) {
+            return discard_output();
+        }
+
+        if (io_throttle_ &&
+            !io_throttle_->AcquireRead(NextReadSize(total_size, read_total), is_cancelled)) {
+            return discard_output();
+        }
+        qint64 chunk_size = 0;
+        {
+            TRACE_SCOPE("ProcessFileWithCodec.read");
+            chunk_size = ReadChunk(in_file, chunk, kChunkSizeBytes, is_cancelled);
+        }
+        if (chunk_size < 0 || (chunk_size == 0 && !in_file.atEnd())) {
+            return discard_output();
+        }
+        if (chunk_size == 0) {
+            break;
+        }
+        if (input_hash_) {
+            input_hash_->addData(QByteArray::fromRawData(chunk, static_cast<int>(chunk_size)));
+        }
+
+        if (compress) {
+            XorChunk(chunk, chunk_size, xor_key_8_bytes, read_total);
+        } else if (read_total == 0 &&
+                   !stream_codec.BeginDecompress(StreamCodec::DetectCodec(chunk, chunk_size))) {
+            // Не кадр кодека, собранного в программу.
+            if (not_compressed) {
+                *not_compressed = true;
+            }
+            return discard_output();
+        }
+        if (!stream_codec.Update(chunk, chunk_size, &coded, write_coded) ||
+            !write_coded()) {
+            return discard_output();
+        }
 
-        read_total += chunk.size();
+        read_total += chunk_size;
         if (progress_callback && total_size > 0) {
             int percent = static_cast<int>((100 * read_total) / total_size);
             if (percent != last_percent) {
@@ -77,6 +395,14 @@ bool FileProcessor::ProcessFile(
         }
     }
 
+    // Пустой вход при распаковке — не кадр, и Finish это отвергнет.
+    if (!compress && read_total == 0 && not_compressed) {
+        *not_compressed = true;
+    }
+    if (!stream_codec.Finish(&coded) || !write_coded()) {
+        return discard_output();
+    }
+
     out_file.close();
     in_file.close();
     if (progress_callback) {
@@ -84,3 +410,74 @@ bool FileProcessor::ProcessFile(
     }
     return true;
 }
+
+bool FileProcessor::ProcessFileToContainer(
+    const QString& input_path,
+    PackedContainerWriter* container,
+    const QString& entry_name,
+    const QByteArray& xor_key_8_bytes,
+    std::function<bool()> is_cancelled) {
+    TRACE_SCOPE("ProcessFileToContainer");
+    if (xor_key_8_bytes.size() != 8 || !container) {
+        return false;
+    }
+
+    QFile in_file(input_path);
+    if (!in_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        return false;
+    }
+
+    BufferPool::Lease buffer = buffer_pool_->Acquire(kChunkSizeBytes, numa_node_, is_cancelled);
+    if (buffer.isNull() || !container->BeginEntry(entry_name)) {
+        return false;
+    }
+    char* chunk = buffer.data();
+
+    auto abort_entry = [container]() {
+        container->AbortEntry();
+        return false;
+    };
+
+    const qint64 total_size = in_file.size();
+    qint64 read_total = 0;
+    while (!in_file.atEnd()) {
+        if (is_cancelled && is_cancelled()) {
+            return abort_entry();
+        }
+
+        if (io_throttle_ &&
+            !io_throttle_->AcquireRead(NextReadSize(total_size, read_total), is_cancelled)) {
+            return abort_entry();
+        }
+        qint64 chunk_size = 0;
+        {
+            TRACE_SCOPE("ProcessFileToContainer.read");
+            chunk_size = ReadChunk(in_file, chunk, kChunkSizeBytes, is_cancelled);
+        }
+        if (chunk_size < 0) {
+            return abort_entry();
+        }
+        if (chunk_size == 0) {
+            break;
+        }
+
+        if (input_hash_) {
+            input_hash_->addData(QByteArray::fromRawData(chunk, static_cast<int>(chunk_size)));
+        }
+        XorChunk(chunk, chunk_size, xor_key_8_bytes, read_total);
+
+        if (io_throttle_ &&
+            !io_throttle_->AcquireWrite(chunk_size, is_cancelled)) {
+            return abort_entry();
+        }
+        {
+            TRACE_SCOPE("ProcessFileToContainer.write");
+            if (!container->AppendData(chunk, chunk_size)) {
+                return abort_entry();
+            }
+        }
+        read_total += chunk_size;
+    }
+
+    return container->EndEntry();
+}
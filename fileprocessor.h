@@ -1,15 +1,47 @@
 #pragma once
 
 #include <QByteArray>
+#include <QCryptographicHash>
 #include <QString>
 
 #include <functional>
+#include <memory>
+
+#include "bufferpool.h"
+#include "streamcodec.h"
+
+class IoThrottle;
+class PackedContainerWriter;
 
 class FileProcessor {
 public:
     static constexpr qint64 kChunkSizeBytes = 1024 * 1024;
 
-    FileProcessor() = default;
+    // Буферы чанков берутся из buffer_pool; без него — из собственного пула.
+    explicit FileProcessor(BufferPool* buffer_pool = nullptr);
+
+    // Узел NUMA, на котором работает поток обработчика (-1 — неизвестен).
+    void SetNumaNode(int numa_node) { numa_node_ = numa_node; }
+
+    void SetIoThrottle(IoThrottle* io_throttle) { io_throttle_ = io_throttle; }
+
+    // Потоки кодека на один большой файл; 0 — по числу ядер. Несколько
+    // обработчиков, работающих одновременно, делят ядра между собой.
+    void SetCodecThreads(int threads) { codec_threads_ = threads; }
+
+    // Если задан, в input_hash добавляются прочитанные данные до XOR.
+    void SetInputHash(QCryptographicHash* input_hash) { input_hash_ = input_hash; }
+
+    enum class SmallFileResult { kDone, kTooLarge, kFailed };
+
+    // Обрабатывает файл не больше max_size_bytes одним чтением и одной
+    // записью, без колбэков. Для больших файлов возвращает kTooLarge,
+    // не создавая выходной файл.
+    SmallFileResult ProcessSmallFile(const QString& input_path,
+                                     const QString& output_path,
+                                     const QByteArray& xor_key_8_bytes,
+                                     qint64 max_size_bytes,
+                                     std::function<bool()> is_cancelled = nullptr);
 
     bool ProcessFile(
         const QString& input_path,
@@ -18,6 +50,58 @@ public:
         std::function<void(int percent)> progress_callback = nullptr,
         std::function<bool()> is_cancelled = nullptr);
 
+    // Пишет XOR входа, сжатый кодеком codec. Файлы от
+    // kMultiThreadCodecBytes сжимаются в нескольких потоках.
+    bool CompressFile(
+        const QString& input_path,
+        const QString& output_path,
+        const QByteArray& xor_key_8_bytes,
+        StreamCodec::Codec codec,
+        std::function<void(int percent)> progress_callback = nullptr,
+        std::function<bool()> is_cancelled = nullptr);
+
+    // Обратный путь к CompressFile: распаковывает вход (кодек — по
+    // заголовку кадра) и применяет XOR к распакованным данным. Если вход
+    // не начинается с кадра кодека этой сборки, not_compressed
+    // выставляется в true.
+    bool DecompressFile(
+        const QString& input_path,
+        const QString& output_path,
+        const QByteArray& xor_key_8_bytes,
+        std::function<void(int percent)> progress_callback = nullptr,
+        std::function<bool()> is_cancelled = nullptr,
+        bool* not_compressed = nullptr);
+
+    // Дописывает XOR входного файла в контейнер записью entry_name.
+    bool ProcessFileToContainer(
+        const QString& input_path,
+        PackedContainerWriter* container,
+        const QString& entry_name,
+        const QByteArray& xor_key_8_bytes,
+        std::function<bool()> is_cancelled = nullptr);
+
+    // key_phase — смещение data от начала файла; ключ применяется
+    // с байта key_phase % 8.
+    static void XorChunk(char* data, qint64 size, const QByteArray& key,
+                         qint64 key_phase);
+
+    static constexpr qint64 kMultiThreadCodecBytes = 64 * 1024 * 1024;
+
 private:
-    static void XorChunk(QByteArray& chunk, const QByteArray& key);
+    bool ProcessFileWithCodec(
+        const QString& input_path,
+        const QString& output_path,
+        const QByteArray& xor_key_8_bytes,
+        StreamCodec::Codec codec,
+        bool compress,
+        const std::function<void(int percent)>& progress_callback,
+        const std::function<bool()>& is_cancelled,
+        bool* not_compressed);
+
+    std::unique_ptr<BufferPool> own_buffer_pool_;
+    BufferPool* buffer_pool_;
+    IoThrottle* io_throttle_ = nullptr;
+    QCryptographicHash* input_hash_ = nullptr;
+    int numa_node_ = -1;
+    int codec_threads_ = 0;
 };
@@ -0,0 +1,142 @@
+#include "filesync.h"
+
+#include "tracing.h"
+
+#include <QFile>
+#include <QFileInfo>
+
+#if defined(Q_OS_WIN)
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+bool FileSync::SyncFile(const QString& path) {
+    TRACE_SCOPE("FileSync::SyncFile");
+    QFile file(path);
+#if defined(Q_OS_WIN)
+    // FlushFileBuffers требует дескриптор с правом записи.
+    if (!file.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    return ::_commit(file.handle()) == 0;
+#else
+    // fsync сбрасывает все грязные страницы файла, а не только
+    // записанные через этот дескриптор.
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+bool FileSync::SyncDirectory(const QString& path) {
+#if defined(Q_OS_WIN)
+    Q_UNUSED(path);
+    return true;
+#else
+    const int fd = ::open(QFile::encodeName(path).constData(),
+                          O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#endif
+}
+
+bool FileSync::SyncFileSystem(const QString& path) {
+#if defined(Q_OS_LINUX)
+    TRACE_SCOPE("FileSync::SyncFileSystem");
+    const int fd = ::open(QFile::encodeName(path).constData(),
+                          O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const bool ok = ::syncfs(fd) == 0;
+    ::close(fd);
+    return ok;
+#else
+    Q_UNUSED(path);
+    return false;
+#endif
+}
+
+GroupCommit::GroupCommit(Settings::Durability mode, int max_files,
+                         int max_interval_ms)
+    : mode_(mode),
+    max_files_(qMax(1, max_files)),
+    max_interval_ms_(max_interval_ms) {}
+
+void GroupCommit::Add(const QString& input_path, const QString& output_path) {
+    if (input_paths_.isEmpty()) {
+        since_first_.start();
+    }
+    input_paths_.append(input_path);
+    if (mode_ != Settings::Durability::kNone) {
+        output_paths_.append(output_path);
+        output_dirs_.insert(QFileInfo(output_path).absolutePath());
+    }
+}
+
+bool GroupCommit::IsDue() const {
+    if (input_paths_.isEmpty()) {
+        return false;
+    }
+    if (mode_ != Settings::Durability::kGroupCommit) {
+        return true;
+    }
+    return input_paths_.size() >= max_files_ ||
+           (max_interval_ms_ > 0 && since_first_.elapsed() >= max_interval_ms_);
+}
+
+bool GroupCommit::Flush(QStringList* committed_inputs) {
+    if (input_paths_.isEmpty()) {
+        return true;
+    }
+    if (!SyncOutputs()) {
+        return false;
+    }
+    if (committed_inputs) {
+        committed_inputs->append(input_paths_);
+    }
+    input_paths_.clear();
+    output_paths_.clear();
+    output_dirs_.clear();
+    return true;
+}
+
+bool GroupCommit::SyncOutputs() const {
+    TRACE_SCOPE("GroupCommit::SyncOutputs");
+    if (mode_ == Settings::Durability::kNone) {
+        return true;
+    }
+
+    // Один syncfs на каталог дешевле fsync каждого из сотен файлов;
+    // где его нет, сбрасываем файлы по одному.
+    bool synced_fs = mode_ == Settings::Durability::kGroupCommit;
+    if (synced_fs) {
+        for (const QString& dir : output_dirs_) {
+            if (!FileSync::SyncFileSystem(dir)) {
+                synced_fs = false;
+                break;
+            }
+        }
+    }
+    if (!synced_fs) {
+        for (const QString& path : output_paths_) {
+            if (!FileSync::SyncFile(path)) {
+                return false;
+            }
+        }
+    }
+
+    for (const QString& dir : output_dirs_) {
+        if (!FileSync::SyncDirectory(dir)) {
+            return false;
+        }
+    }
+    return true;
+}
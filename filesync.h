@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+#include "settings.h"
+
+class FileSync {
+public:
+    // fsync файла по пути (на Windows — FlushFileBuffers).
+    static bool SyncFile(const QString& path);
+    // fsync каталога, чтобы пережили сбой сами записи о новых файлах;
+    // на Windows не требуется.
+    static bool SyncDirectory(const QString& path);
+    // syncfs файловой системы, на которой лежит path; false, если
+    // платформа этого не умеет.
+    static bool SyncFileSystem(const QString& path);
+};
+
+// Копит завершённые файлы и сбрасывает их выходы на диск пачкой. Входы
+// выдаются наружу (для удаления) только после успешного сброса.
+class GroupCommit {
+public:
+    GroupCommit(Settings::Durability mode, int max_files, int max_interval_ms);
+
+    void Add(const QString& input_path, const QString& output_path);
+    int pending() const { return input_paths_.size(); }
+
+    // Пора ли вызывать Flush: в режимах kNone и kPerFile — сразу после
+    // каждого файла, в kGroupCommit — по числу файлов или по времени.
+    bool IsDue() const;
+
+    // Сбрасывает накопленные выходы и возвращает их входы. При ошибке
+    // возвращает false, входы остаются в очереди.
+    bool Flush(QStringList* committed_inputs);
+
+private:
+    bool SyncOutputs() const;
+
+    Settings::Durability mode_;
+    int max_files_;
+    int max_interval_ms_;
+    QStringList input_paths_;
+    QStringList output_paths_;
+    QSet<QString> output_dirs_;
+    QElapsedTimer since_first_;
+};
@@ -0,0 +1,114 @@
+#include "iothrottle.h"
+
+#include "tracing.h"
+
+#include <QThread>
+#include <QTime>
+
+#include <cmath>
+
+namespace {
+// Шаг ожидания, с которым проверяется отмена.
+constexpr qint64 kWaitSliceMs = 10;
+}
+
+IoThrottle::IoThrottle() {
+    clock_.start();
+}
+
+void IoThrottle::Configure(const Settings& settings) {
+    QMutexLocker locker(&mutex_);
+    limits_ = settings.io_limits();
+    business_hours_only_ = settings.io_limits_business_hours_only();
+    business_hours_start_ = settings.business_hours_start();
+    business_hours_end_ = settings.business_hours_end();
+}
+
+bool IoThrottle::AcquireRead(qint64 bytes,
+                             const std::function<bool()>& is_cancelled) {
+    QMutexLocker locker(&mutex_);
+    const Settings::IoLimits limits = ActiveLimitsLocked();
+    locker.unlock();
+    return Acquire(read_bytes_, read_ops_, limits.read_bytes_per_sec,
+                   limits.read_ops_per_sec, bytes, is_cancelled);
+}
+
+bool IoThrottle::AcquireWrite(qint64 bytes,
+                              const std::function<bool()>& is_cancelled) {
+    QMutexLocker locker(&mutex_);
+    const Settings::IoLimits limits = ActiveLimitsLocked();
+    locker.unlock();
+    return Acquire(write_bytes_, write_ops_, limits.write_bytes_per_sec,
+                   limits.write_ops_per_sec, bytes, is_cancelled);
+}
+
+bool IoThrottle::Acquire(Bucket& bytes_bucket, Bucket& ops_bucket,
+                         qint64 bytes_rate, qint64 ops_rate, qint64 bytes,
+                         const std::function<bool()>& is_cancelled) {
+    if (bytes_rate <= 0 && ops_rate <= 0) {
+        return true;
+    }
+
+    qint64 wait_ms = 0;
+    {
+        QMutexLocker locker(&mutex_);
+        const qint64 now_ms = clock_.elapsed();
+        wait_ms = qMax(ReserveLocked(bytes_bucket, bytes_rate, bytes, now_ms),
+                       ReserveLocked(ops_bucket, ops_rate, 1.0, now_ms));
+    }
+
+    if (wait_ms <= 0) {
+        return true;
+    }
+
+    TRACE_SCOPE("IoThrottle.wait");
+    while (wait_ms > 0) {
+        if (is_cancelled && is_cancelled()) {
+            return false;
+        }
+        const qint64 slice = qMin(wait_ms, kWaitSliceMs);
+        QThread::msleep(static_cast<unsigned long>(slice));
+        wait_ms -= slice;
+    }
+    return true;
+}
+
+qint64 IoThrottle::ReserveLocked(Bucket& bucket, qint64 rate, double amount,
+                                 qint64 now_ms) {
+    if (rate <= 0) {
+        bucket.rate = 0.0;
+        return 0;
+    }
+
+    // Ёмкость корзины — секунда трафика; после смены лимита корзина
+    // начинает полной, а долг переносится.
+    const double capacity = static_cast<double>(rate);
+    if (bucket.rate != capacity) {
+        bucket.tokens = bucket.rate == 0.0 ? capacity
+                                           : qMin(bucket.tokens, capacity);
+        bucket.rate = capacity;
+        bucket.last_refill_ms = now_ms;
+    }
+
+    const double elapsed_sec = (now_ms - bucket.last_refill_ms) / 1000.0;
+    bucket.tokens = qMin(capacity, bucket.tokens + elapsed_sec * bucket.rate);
+    bucket.last_refill_ms = now_ms;
+
+    bucket.tokens -= amount;
+    if (bucket.tokens >= 0.0) {
+        return 0;
+    }
+    return static_cast<qint64>(std::ceil(-bucket.tokens * 1000.0 / bucket.rate));
+}
+
+Settings::IoLimits IoThrottle::ActiveLimitsLocked() const {
+    if (!business_hours_only_) {
+        return limits_;
+    }
+    const int hour = QTime::currentTime().hour();
+    const bool in_business_hours =
+        business_hours_start_ <= business_hours_end_
+            ? hour >= business_hours_start_ && hour < business_hours_end_
+            : hour >= business_hours_start_ || hour < business_hours_end_;
+    return in_business_hours ? limits_ : Settings::IoLimits();
+}
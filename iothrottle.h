@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QtGlobal>
+
+#include <functional>
+
+#include "settings.h"
+
+// Ограничитель скорости ввода-вывода на маркерных корзинах, общий для
+// всех воркеров. Лимиты можно менять на ходу через Configure.
+class IoThrottle {
+public:
+    IoThrottle();
+
+    void Configure(const Settings& settings);
+
+    // Списывают bytes байт и одну операцию; при превышении лимита ждут,
+    // периодически проверяя is_cancelled. false — если ожидание прервано.
+    bool AcquireRead(qint64 bytes,
+                     const std::function<bool()>& is_cancelled = nullptr);
+    bool AcquireWrite(qint64 bytes,
+                      const std::function<bool()>& is_cancelled = nullptr);
+
+private:
+    struct Bucket {
+        double rate = 0.0;
+        double tokens = 0.0;
+        qint64 last_refill_ms = 0;
+    };
+
+    bool Acquire(Bucket& bytes_bucket, Bucket& ops_bucket,
+                 qint64 bytes_rate, qint64 ops_rate, qint64 bytes,
+                 const std::function<bool()>& is_cancelled);
+    qint64 ReserveLocked(Bucket& bucket, qint64 rate, double amount,
+                         qint64 now_ms);
+    Settings::IoLimits ActiveLimitsLocked() const;
+
+    mutable QMutex mutex_;
+    QElapsedTimer clock_;
+    Settings::IoLimits limits_;
+    bool business_hours_only_ = false;
+    int business_hours_start_ = 9;
+    int business_hours_end_ = 18;
+
+    Bucket read_bytes_;
+    Bucket read_ops_;
+    Bucket write_bytes_;
+    Bucket write_ops_;
+};
@@ -1,13 +1,21 @@
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
+#include "streamcodec.h"
+#include "tracing.h"
 
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QMessageBox>
 #include <QRegularExpression>
 
 namespace {
 constexpr int kXorKeyBytes = 8;
 constexpr int kHexCharsPerByte = 2;
+constexpr qint64 kBytesPerKb = 1024;
+constexpr qint64 kBytesPerMb = 1024 * 1024;
+// Больше файлов план в лог не выводит, только их число.
+constexpr int kMaxPlanFilesListed = 1000;
+constexpr int kJobsRefreshIntervalMs = 1000;
 }
 
 MainWindow::MainWindow(QWidget* parent)
@@ -23,6 +31,8 @@ MainWindow::MainWindow(QWidget* parent)
             this, &MainWindow::OnSchedulerStopped);
     connect(scheduler_.get(), &TaskScheduler::ProgressOverall,
             this, &MainWindow::OnProgressOverall);
+    connect(scheduler_.get(), &TaskScheduler::EstimatedTimeLeft,
+            this, &MainWindow::OnEstimatedTimeLeft);
     connect(scheduler_.get(), &TaskScheduler::ProgressFile,
             this, &MainWindow::OnProgressFile);
     connect(scheduler_.get(), &TaskScheduler::StatusMessage,
@@ -44,8 +54,34 @@ MainWindow::MainWindow(QWidget* parent)
             this, &MainWindow::OnBrowseOutputButtonClicked);
     connect(ui->startStopButton, &QPushButton::clicked,
             this, &MainWindow::OnStartStopButtonClicked);
+    connect(ui->addJobButton, &QPushButton::clicked,
+            this, &MainWindow::OnAddJobButtonClicked);
+    connect(ui->stopJobButton, &QPushButton::clicked,
+            this, &MainWindow::OnStopJobButtonClicked);
+    connect(ui->planButton, &QPushButton::clicked,
+            this, &MainWindow::OnPlanButtonClicked);
+    // Через очередь: сигнал приходит изнутри обхода заданий планировщиком.
+    // Итог задания остаётся в списке после его удаления из планировщика.
+    connect(scheduler_.get(), &TaskScheduler::JobFinished, this,
+            [this](int job_id) {
+                if (job_id == TaskScheduler::kDefaultJobId) {
+                    return;
+                }
+                if (running_jobs_.contains(job_id)) {
+                    UpdateJobItem(job_id, true);
+                    running_jobs_.remove(job_id);
+                }
+                scheduler_->RemoveJob(job_id);
+            },
+            Qt::QueuedConnection);
+    jobs_refresh_timer_.setInterval(kJobsRefreshIntervalMs);
+    connect(&jobs_refresh_timer_, &QTimer::timeout,
+            this, &MainWindow::RefreshJobItems);
     connect(ui->clearLogButton, &QPushButton::clicked,
             this, &MainWindow::OnClearLogButtonClicked);
+    connect(ui->saveTraceButton, &QPushButton::clicked,
+            this, &MainWindow::OnSaveTraceButtonClicked);
+    ui->saveTraceButton->setVisible(Tracer::kEnabled);
 
     ConnectUiToSettings();
 }
@@ -60,6 +96,34 @@ void MainWindow::ConnectUiToSettings() {
     connect(ui->deleteInputCheckBox, &QCheckBox::toggled, this,
             [this](bool checked) { settings_.set_delete_input_files(checked); });
 
+    connect(ui->packOutputCheckBox, &QCheckBox::toggled, this,
+            [this](bool checked) {
+                settings_.set_output_format(checked ? Settings::OutputFormat::kContainer
+                                                    : Settings::OutputFormat::kFiles);
+            });
+
+    connect(ui->persistentQueueCheckBox, &QCheckBox::toggled, this,
+            [this](bool checked) { settings_.set_persistent_queue(checked); });
+
+    connect(ui->durabilityComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, [this](int index) {
+                settings_.set_durability(static_cast<Settings::Durability>(index));
+            });
+
+    connect(ui->compressionComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, [this](int index) {
+                settings_.set_compression(static_cast<Settings::Compression>(index));
+            });
+    connect(ui->dedupComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, [this](int index) {
+                settings_.set_dedup_mode(static_cast<Settings::DedupMode>(index));
+            });
+
+    if (StreamCodec::BuiltinCodec() == StreamCodec::Codec::kNone) {
+        ui->compressionComboBox->setEnabled(false);
+        ui->compressionComboBox->setToolTip(tr("Программа собрана без zstd и LZ4"));
+    }
+
     connect(ui->overwriteOutputRadioButton, &QRadioButton::toggled, this,
             [this](bool checked) {
                 if (checked) {
@@ -93,7 +157,69 @@ void MainWindow::ConnectUiToSettings() {
                 settings_.set_xor_key_8_bytes(ParseHexTo8Bytes(text.trimmed()));
             });
 
+    connect(ui->schedulingPolicyComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, [this](int index) {
+                settings_.set_scheduling_policy(static_cast<Settings::SchedulingPolicy>(index));
+            });
+
+    connect(ui->smallFileThresholdSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, [this](int value) {
+                settings_.set_small_file_threshold_bytes(static_cast<qint64>(value) * kBytesPerKb);
+            });
+
+    connect(ui->cpuSetEdit, &QLineEdit::textChanged, this,
+            [this](const QString& text) { settings_.set_cpu_set(text.trimmed()); });
+
+    connect(ui->pinWorkerThreadsCheckBox, &QCheckBox::toggled, this,
+            [this](bool checked) { settings_.set_pin_worker_threads(checked); });
+
+    connect(ui->prefetchFilesSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, [this](int value) { settings_.set_prefetch_files(value); });
+
+    connect(ui->prefetchBudgetSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, [this](int value) {
+                settings_.set_prefetch_budget_bytes(static_cast<qint64>(value) * kBytesPerMb);
+            });
+
+    connect(ui->smallFileFastPathSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, [this](int value) {
+                settings_.set_small_file_fast_path_bytes(static_cast<qint64>(value) * kBytesPerKb);
+            });
+
+    connect(ui->batchMaxFilesSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, [this](int value) { settings_.set_batch_max_files(value); });
+
+    connect(ui->bufferPoolBudgetSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, [this](int value) {
+                settings_.set_buffer_pool_budget_bytes(static_cast<qint64>(value) * kBytesPerMb);
+            });
+
+    connect(ui->useHugePagesCheckBox, &QCheckBox::toggled, this,
+            [this](bool checked) { settings_.set_use_huge_pages(checked); });
+
+    for (QSpinBox* spin_box : {ui->readBytesLimitSpinBox, ui->readOpsLimitSpinBox,
+                               ui->writeBytesLimitSpinBox, ui->writeOpsLimitSpinBox}) {
+        connect(spin_box, QOverload<int>::of(&QSpinBox::valueChanged),
+                this, &MainWindow::OnIoLimitsChanged);
+    }
+    connect(ui->businessHoursOnlyCheckBox, &QCheckBox::toggled,
+            this, &MainWindow::OnIoLimitsChanged);
+    for (QSpinBox* spin_box : {ui->businessHoursStartSpinBox, ui->businessHoursEndSpinBox}) {
+        connect(spin_box, QOverload<int>::of(&QSpinBox::valueChanged),
+                this, &MainWindow::OnIoLimitsChanged);
+    }
+
     settings_.set_delete_input_files(ui->deleteInputCheckBox->isChecked());
+    settings_.set_output_format(ui->packOutputCheckBox->isChecked()
+                                    ? Settings::OutputFormat::kContainer
+                                    : Settings::OutputFormat::kFiles);
+    settings_.set_persistent_queue(ui->persistentQueueCheckBox->isChecked());
+    settings_.set_durability(
+        static_cast<Settings::Durability>(ui->durabilityComboBox->currentIndex()));
+    settings_.set_compression(
+        static_cast<Settings::Compression>(ui->compressionComboBox->currentIndex()));
+    settings_.set_dedup_mode(
+        static_cast<Settings::DedupMode>(ui->dedupComboBox->currentIndex()));
     settings_.set_output_name_conflict(
         ui->overwriteOutputRadioButton->isChecked()
             ? Settings::OutputNameConflict::kOverwrite
@@ -105,6 +231,35 @@ void MainWindow::ConnectUiToSettings() {
     settings_.set_check_files_interval_sec(ui->checkFilesIntervalSpinBox->value());
     settings_.set_input_file_mask(ui->inputMaskEdit->text().trimmed());
     settings_.set_xor_key_8_bytes(ParseHexTo8Bytes(ui->inputKeyEdit->text().trimmed()));
+    settings_.set_scheduling_policy(
+        static_cast<Settings::SchedulingPolicy>(ui->schedulingPolicyComboBox->currentIndex()));
+    settings_.set_small_file_threshold_bytes(
+        static_cast<qint64>(ui->smallFileThresholdSpinBox->value()) * kBytesPerKb);
+    settings_.set_cpu_set(ui->cpuSetEdit->text().trimmed());
+    settings_.set_pin_worker_threads(ui->pinWorkerThreadsCheckBox->isChecked());
+    settings_.set_prefetch_files(ui->prefetchFilesSpinBox->value());
+    settings_.set_prefetch_budget_bytes(
+        static_cast<qint64>(ui->prefetchBudgetSpinBox->value()) * kBytesPerMb);
+    settings_.set_small_file_fast_path_bytes(
+        static_cast<qint64>(ui->smallFileFastPathSpinBox->value()) * kBytesPerKb);
+    settings_.set_batch_max_files(ui->batchMaxFilesSpinBox->value());
+    settings_.set_buffer_pool_budget_bytes(
+        static_cast<qint64>(ui->bufferPoolBudgetSpinBox->value()) * kBytesPerMb);
+    settings_.set_use_huge_pages(ui->useHugePagesCheckBox->isChecked());
+    OnIoLimitsChanged();
+}
+
+void MainWindow::OnIoLimitsChanged() {
+    Settings::IoLimits limits;
+    limits.read_bytes_per_sec = static_cast<qint64>(ui->readBytesLimitSpinBox->value()) * kBytesPerMb;
+    limits.read_ops_per_sec = ui->readOpsLimitSpinBox->value();
+    limits.write_bytes_per_sec = static_cast<qint64>(ui->writeBytesLimitSpinBox->value()) * kBytesPerMb;
+    limits.write_ops_per_sec = ui->writeOpsLimitSpinBox->value();
+    settings_.set_io_limits(limits);
+    settings_.set_io_limits_business_hours_only(ui->businessHoursOnlyCheckBox->isChecked());
+    settings_.set_business_hours_start(ui->businessHoursStartSpinBox->value());
+    settings_.set_business_hours_end(ui->businessHoursEndSpinBox->value());
+    scheduler_->UpdateIoLimits(settings_);
 }
 
 QByteArray MainWindow::ParseHexTo8Bytes(const QString& hex_string) {
@@ -141,37 +296,160 @@ void MainWindow::OnStartStopButtonClicked() {
         ui->statusStatusLabel->setText(tr("Готово"));
         ui->currentFileProgressBar->setValue(0);
         ui->overallProgressBar->setValue(0);
+        ui->etaLabel->clear();
         return;
     }
 
+    if (!ValidateJobSettings()) {
+        return;
+    }
+
+    scheduler_->SetSettings(settings_);
+    scheduler_->Start();
+}
+
+void MainWindow::OnAddJobButtonClicked() {
+    if (!ValidateJobSettings()) {
+        return;
+    }
+
+    if (!scheduler_->IsRunning()) {
+        // Пул воркеров настраивается по основному заданию.
+        scheduler_->SetSettings(settings_);
+    }
+    const QString name = QString("%1/%2").arg(QFileInfo(settings_.input_directory()).fileName(),
+                                              settings_.input_file_mask());
+    const int job_id = scheduler_->AddJob(name, settings_, ui->jobWeightSpinBox->value());
+    running_jobs_.insert(job_id, name);
+    if (!scheduler_->StartJob(job_id)) {
+        running_jobs_.remove(job_id);
+        scheduler_->RemoveJob(job_id);
+        return;
+    }
+    UpdateJobItem(job_id, false);
+    jobs_refresh_timer_.start();
+}
+
+void MainWindow::OnStopJobButtonClicked() {
+    const QListWidgetItem* item = ui->jobsListWidget->currentItem();
+    if (!item) {
+        return;
+    }
+    const int job_id = item->data(Qt::UserRole).toInt();
+    if (running_jobs_.contains(job_id)) {
+        scheduler_->StopJob(job_id);
+    }
+}
+
+void MainWindow::UpdateJobItem(int job_id, bool finished) {
+    QListWidgetItem* item = nullptr;
+    for (int i = 0; i < ui->jobsListWidget->count(); ++i) {
+        if (ui->jobsListWidget->item(i)->data(Qt::UserRole).toInt() == job_id) {
+            item = ui->jobsListWidget->item(i);
+            break;
+        }
+    }
+    if (!item) {
+        item = new QListWidgetItem(ui->jobsListWidget);
+        item->setData(Qt::UserRole, job_id);
+    }
+
+    const TaskScheduler::JobMetrics metrics = scheduler_->GetJobMetrics(job_id);
+    QString text = tr("%1: обработано %2 файл(ов), %3 МБ, ошибок %4")
+                       .arg(running_jobs_.value(job_id))
+                       .arg(metrics.processed_files)
+                       .arg(metrics.processed_bytes / kBytesPerMb)
+                       .arg(metrics.errors);
+    text += finished ? tr(" — завершено")
+                     : tr(", в очереди %1").arg(metrics.pending_files);
+    item->setText(text);
+}
+
+void MainWindow::RefreshJobItems() {
+    if (running_jobs_.isEmpty()) {
+        jobs_refresh_timer_.stop();
+        return;
+    }
+    for (auto it = running_jobs_.constBegin(); it != running_jobs_.constEnd(); ++it) {
+        UpdateJobItem(it.key(), false);
+    }
+}
+
+void MainWindow::OnPlanButtonClicked() {
+    if (!ValidateJobSettings()) {
+        return;
+    }
+
+    const FileManager::RunPlan plan =
+        file_manager_->PlanRun(settings_, scheduler_->measured_bytes_per_sec());
+    ui->logTextEdit->appendPlainText(tr("План обработки (файлы не изменяются):"));
+    for (int i = 0; i < plan.files.size() && i < kMaxPlanFilesListed; ++i) {
+        ui->logTextEdit->appendPlainText(QString("  %1 (%2 КБ)")
+                                             .arg(plan.files.at(i))
+                                             .arg((plan.sizes.at(i) + kBytesPerKb - 1) / kBytesPerKb));
+    }
+    if (plan.files.size() > kMaxPlanFilesListed) {
+        ui->logTextEdit->appendPlainText(
+            tr("  ... и ещё %1 файл(ов)").arg(plan.files.size() - kMaxPlanFilesListed));
+    }
+
+    ui->logTextEdit->appendPlainText(tr("Файлов: %1, объём: %2 МБ")
+                                         .arg(plan.files.size())
+                                         .arg(plan.total_bytes / kBytesPerMb));
+    ui->logTextEdit->appendPlainText(
+        plan.estimated_duration_ms < 0
+            ? tr("Оценка времени: нет данных о скорости, нужен хотя бы один запуск")
+            : tr("Оценка времени: %1").arg(FormatDuration((plan.estimated_duration_ms + 999) / 1000)));
+    QString disk_line = tr("Пик занятого места: %1 МБ").arg(plan.peak_disk_bytes / kBytesPerMb);
+    if (plan.available_disk_bytes >= 0) {
+        disk_line += tr(", свободно: %1 МБ").arg(plan.available_disk_bytes / kBytesPerMb);
+    }
+    ui->logTextEdit->appendPlainText(disk_line);
+    if (plan.available_disk_bytes >= 0 && plan.peak_disk_bytes > plan.available_disk_bytes) {
+        OnErrorOccurred(tr("В выходной папке не хватит места для этого запуска"));
+    }
+}
+
+bool MainWindow::ValidateJobSettings() {
     if (!file_manager_->IsValid()) {
         QMessageBox::warning(this, tr("Ошибка"), tr("Не заданы входная папка или маска файлов."));
-        return;
+        return false;
     }
 
     if (settings_.xor_key_8_bytes().size() != 8) {
         QMessageBox::warning(this, tr("Ошибка"), tr("Ключ XOR должен быть 8 байт (16 hex-символов)."));
-        return;
+        return false;
     }
 
     if (settings_.output_directory().isEmpty()) {
         QMessageBox::warning(this, tr("Ошибка"), tr("Не указана выходная папка."));
-        return;
+        return false;
     }
-
-    scheduler_->SetSettings(settings_);
-    scheduler_->Start();
+    return true;
 }
 
 void MainWindow::OnClearLogButtonClicked() {
     ui->logTextEdit->clear();
 }
 
+void MainWindow::OnSaveTraceButtonClicked() {
+    QString path = QFileDialog::getSaveFileName(this, tr("Сохранение трассы"),
+                                                "trace.json", tr("Trace JSON (*.json)"));
+    if (path.isEmpty()) return;
+
+    if (Tracer::WriteChromeTrace(path)) {
+        ui->logTextEdit->appendPlainText(tr("Трасса сохранена: %1").arg(path));
+    } else {
+        OnErrorOccurred(tr("Не удалось сохранить трассу: %1").arg(path));
+    }
+}
+
 void MainWindow::OnSchedulerStarted() {
     ui->startStopButton->setText(tr("Стоп"));
     ui->statusStatusLabel->setText(tr("Запущен"));
     ui->currentFileProgressBar->setValue(0);
     ui->overallProgressBar->setValue(0);
+    ui->etaLabel->clear();
 }
 
 void MainWindow::OnSchedulerStopped() {
@@ -179,12 +457,25 @@ void MainWindow::OnSchedulerStopped() {
     ui->statusStatusLabel->setText(tr("Готово"));
     ui->currentFileProgressBar->setValue(0);
     ui->overallProgressBar->setValue(0);
+    ui->etaLabel->clear();
 }
 
 void MainWindow::OnProgressOverall(int percent) {
     ui->overallProgressBar->setValue(percent);
 }
 
+void MainWindow::OnEstimatedTimeLeft(qint64 seconds) {
+    ui->etaLabel->setText(seconds < 0 ? tr("Осталось: оценка...")
+                                      : tr("Осталось: %1").arg(FormatDuration(seconds)));
+}
+
+QString MainWindow::FormatDuration(qint64 seconds) {
+    return QString("%1:%2:%3")
+        .arg(seconds / 3600)
+        .arg((seconds / 60) % 60, 2, 10, QChar('0'))
+        .arg(seconds % 60, 2, 10, QChar('0'));
+}
+
 void MainWindow::OnProgressFile(const QString& file_name, int percent) {
     ui->currentFileStatusLabel->setText(file_name);
     ui->currentFileProgressBar->setValue(percent);
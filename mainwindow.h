@@ -1,6 +1,8 @@
 #pragma once
 
+#include <QHash>
 #include <QMainWindow>
+#include <QTimer>
 #include <memory>
 
 #include "filemanager.h"
@@ -24,21 +26,35 @@ private slots:
     void OnBrowseInputButtonClicked();
     void OnBrowseOutputButtonClicked();
     void OnStartStopButtonClicked();
+    void OnAddJobButtonClicked();
+    void OnStopJobButtonClicked();
+    void OnPlanButtonClicked();
     void OnClearLogButtonClicked();
+    void OnSaveTraceButtonClicked();
 
 private:
     void ConnectUiToSettings();
+    bool ValidateJobSettings();
+    void OnIoLimitsChanged();
+    // Строка задания в списке; finished — итог, задание больше не идёт.
+    void UpdateJobItem(int job_id, bool finished);
+    void RefreshJobItems();
     void OnSchedulerStarted();
     void OnSchedulerStopped();
     void OnProgressOverall(int percent);
+    void OnEstimatedTimeLeft(qint64 seconds);
     void OnProgressFile(const QString& file_name, int percent);
     void OnStatusMessage(const QString& message);
     void OnErrorOccurred(const QString& message);
 
     static QByteArray ParseHexTo8Bytes(const QString& hex_string);
+    static QString FormatDuration(qint64 seconds);
 
     std::unique_ptr<Ui::MainWindow> ui;
     Settings settings_;
     std::unique_ptr<FileManager> file_manager_;
     std::unique_ptr<TaskScheduler> scheduler_;
+    // Имена добавленных заданий, которые ещё идут.
+    QHash<int, QString> running_jobs_;
+    QTimer jobs_refresh_timer_;
 };
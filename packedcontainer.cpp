@@ -0,0 +1,317 @@
+#include "packedcontainer.h"
+
+#include "fileprocessor.h"
+
+#include <QDir>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace {
+
+constexpr char kMagic[4] = {'B', 'O', 'P', 'K'};
+constexpr char kIndexMagic[4] = {'B', 'O', 'P', 'X'};
+constexpr quint32 kVersion = 1;
+constexpr qint64 kHeaderSize = 8;
+constexpr qint64 kFooterSize = 16;
+
+const quint32* Crc32Table() {
+    static const auto table = [] {
+        static quint32 values[256];
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+            }
+            values[i] = crc;
+        }
+        return values;
+    }();
+    return table;
+}
+
+// Продолжает CRC-32 (IEEE); начальное значение 0xFFFFFFFF, итог
+// инвертируется вызывающим.
+quint32 Crc32Update(quint32 crc, const char* data, qint64 size) {
+    const quint32* table = Crc32Table();
+    for (qint64 i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<uchar>(data[i])) & 0xFFu] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+// Имя записи приходит из файла контейнера: извлекаются только записи с
+// простым именем файла, без каталогов и "..".
+bool IsPlainFileName(const QString& name) {
+    return !name.isEmpty() && name != "." && name != ".." &&
+           !name.contains('/') && !name.contains('\\') && !name.contains(':');
+}
+
+template <typename T>
+void AppendLittleEndian(QByteArray& out, T value) {
+    char bytes[sizeof(T)];
+    qToLittleEndian(value, bytes);
+    out.append(bytes, static_cast<int>(sizeof(T)));
+}
+
+}  // namespace
+
+PackedContainerWriter::~PackedContainerWriter() {
+    if (file_.isOpen()) {
+        Discard();
+    }
+}
+
+bool PackedContainerWriter::Open(const QString& path) {
+    file_.setFileName(path);
+    if (!file_.open(QIODevice::WriteOnly | QIODevice::NewOnly)) {
+        return false;
+    }
+
+    QByteArray header(kMagic, sizeof(kMagic));
+    AppendLittleEndian<quint32>(header, kVersion);
+    if (file_.write(header) != header.size()) {
+        Discard();
+        return false;
+    }
+
+    entries_.clear();
+    in_entry_ = false;
+    data_end_ = kHeaderSize;
+    return true;
+}
+
+bool PackedContainerWriter::BeginEntry(const QString& name) {
+    if (!file_.isOpen()) {
+        return false;
+    }
+    if (in_entry_) {
+        AbortEntry();
+    }
+
+    current_ = Entry();
+    current_.name = name.toUtf8();
+    current_.offset = data_end_;
+    current_.crc32 = 0xFFFFFFFFu;
+    in_entry_ = true;
+    return file_.seek(data_end_);
+}
+
+bool PackedContainerWriter::AppendData(const char* data, qint64 size) {
+    if (!in_entry_) {
+        return false;
+    }
+    if (size > 0 && file_.write(data, size) != size) {
+        return false;
+    }
+    current_.crc32 = Crc32Update(current_.crc32, data, size);
+    current_.size += size;
+    return true;
+}
+
+bool PackedContainerWriter::EndEntry() {
+    if (!in_entry_) {
+        return false;
+    }
+    current_.crc32 ^= 0xFFFFFFFFu;
+    entries_.append(current_);
+    data_end_ += current_.size;
+    in_entry_ = false;
+    return true;
+}
+
+void PackedContainerWriter::AbortEntry() {
+    in_entry_ = false;
+    file_.seek(data_end_);
+}
+
+bool PackedContainerWriter::Finish() {
+    if (!file_.isOpen()) {
+        return false;
+    }
+    if (in_entry_) {
+        AbortEntry();
+    }
+
+    QByteArray index;
+    for (const Entry& entry : entries_) {
+        AppendLittleEndian<quint32>(index, static_cast<quint32>(entry.name.size()));
+        index.append(entry.name);
+        AppendLittleEndian<quint64>(index, static_cast<quint64>(entry.offset));
+        AppendLittleEndian<quint64>(index, static_cast<quint64>(entry.size));
+        AppendLittleEndian<quint32>(index, entry.crc32);
+    }
+    AppendLittleEndian<quint64>(index, static_cast<quint64>(data_end_));
+    AppendLittleEndian<quint32>(index, static_cast<quint32>(entries_.size()));
+    index.append(kIndexMagic, sizeof(kIndexMagic));
+
+    const bool ok = file_.seek(data_end_) &&
+                    file_.write(index) == index.size() &&
+                    file_.resize(data_end_ + index.size());
+    file_.close();
+    return ok;
+}
+
+void PackedContainerWriter::Discard() {
+    file_.close();
+    file_.remove();
+    entries_.clear();
+    in_entry_ = false;
+}
+
+PackedContainerReader::~PackedContainerReader() {
+    Close();
+}
+
+bool PackedContainerReader::Open(const QString& path) {
+    Close();
+
+    file_.setFileName(path);
+    if (!file_.open(QIODevice::ReadOnly)) {
+        return Fail(QString("Не удалось открыть контейнер: %1").arg(path));
+    }
+    map_size_ = file_.size();
+    if (map_size_ < kHeaderSize + kFooterSize) {
+        return Fail("Контейнер слишком мал");
+    }
+    map_ = file_.map(0, map_size_);
+    if (!map_) {
+        return Fail("Не удалось отобразить контейнер в память");
+    }
+
+    const char* base = reinterpret_cast<const char*>(map_);
+    if (std::memcmp(base, kMagic, sizeof(kMagic)) != 0 ||
+        qFromLittleEndian<quint32>(base + 4) != kVersion) {
+        return Fail("Неизвестный формат контейнера");
+    }
+
+    const char* footer = base + map_size_ - kFooterSize;
+    if (std::memcmp(footer + 12, kIndexMagic, sizeof(kIndexMagic)) != 0) {
+        return Fail("Контейнер не завершён: нет индекса");
+    }
+    const qint64 index_offset =
+        static_cast<qint64>(qFromLittleEndian<quint64>(footer));
+    const quint32 count = qFromLittleEndian<quint32>(footer + 8);
+    if (index_offset < kHeaderSize || index_offset > map_size_ - kFooterSize) {
+        return Fail("Повреждён индекс контейнера");
+    }
+
+    const char* cursor = base + index_offset;
+    const char* index_end = footer;
+    // count из повреждённого файла может быть огромным; запись индекса
+    // занимает не меньше 24 байт.
+    entries_.reserve(static_cast<int>(qMin<qint64>(count, (index_end - cursor) / 24)));
+    for (quint32 i = 0; i < count; ++i) {
+        if (index_end - cursor < 4) {
+            return Fail("Повреждён индекс контейнера");
+        }
+        const quint32 name_size = qFromLittleEndian<quint32>(cursor);
+        cursor += 4;
+        if (index_end - cursor < static_cast<qint64>(name_size) + 20) {
+            return Fail("Повреждён индекс контейнера");
+        }
+
+        Entry entry;
+        entry.name = QString::fromUtf8(cursor, static_cast<int>(name_size));
+        cursor += name_size;
+        entry.offset = static_cast<qint64>(qFromLittleEndian<quint64>(cursor));
+        entry.size = static_cast<qint64>(qFromLittleEndian<quint64>(cursor + 8));
+        entry.crc32 = qFromLittleEndian<quint32>(cursor + 16);
+        cursor += 20;
+
+        // Сумма offset + size могла бы переполниться, поэтому размер
+        // сравнивается с остатком до индекса.
+        if (entry.offset < kHeaderSize || entry.offset > index_offset ||
+            entry.size < 0 || entry.size > index_offset - entry.offset) {
+            return Fail("Повреждён индекс контейнера");
+        }
+        name_index_.insert(entry.name, entries_.size());
+        entries_.append(entry);
+    }
+    return true;
+}
+
+void PackedContainerReader::Close() {
+    if (map_) {
+        file_.unmap(const_cast<uchar*>(map_));
+        map_ = nullptr;
+    }
+    map_size_ = 0;
+    file_.close();
+    entries_.clear();
+    name_index_.clear();
+}
+
+const char* PackedContainerReader::EntryData(int index) const {
+    if (!map_ || index < 0 || index >= entries_.size()) {
+        return nullptr;
+    }
+    return reinterpret_cast<const char*>(map_) + entries_.at(index).offset;
+}
+
+bool PackedContainerReader::Verify(int index) const {
+    const char* data = EntryData(index);
+    if (!data) {
+        return false;
+    }
+    const Entry& entry = entries_.at(index);
+    return (Crc32Update(0xFFFFFFFFu, data, entry.size) ^ 0xFFFFFFFFu) ==
+           entry.crc32;
+}
+
+bool PackedContainerReader::ExtractTo(int index, const QString& path,
+                                      const QByteArray& xor_key_8_bytes) const {
+    const char* data = EntryData(index);
+    if (!data) {
+        return false;
+    }
+    const qint64 size = entries_.at(index).size;
+
+    QFile out_file(path);
+    if (!out_file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    if (xor_key_8_bytes.size() != 8) {
+        const bool ok = out_file.write(data, size) == size;
+        out_file.close();
+        return ok;
+    }
+
+    QByteArray chunk;
+    for (qint64 offset = 0; offset < size;
+         offset += FileProcessor::kChunkSizeBytes) {
+        const qint64 chunk_size =
+            qMin(FileProcessor::kChunkSizeBytes, size - offset);
+        chunk = QByteArray(data + offset, static_cast<int>(chunk_size));
+        FileProcessor::XorChunk(chunk.data(), chunk_size, xor_key_8_bytes,
+                                offset);
+        if (out_file.write(chunk) != chunk_size) {
+            out_file.close();
+            out_file.remove();
+            return false;
+        }
+    }
+    out_file.close();
+    return true;
+}
+
+int PackedContainerReader::ExtractAll(const QString& directory,
+                                      const QByteArray& xor_key_8_bytes) const {
+    const QDir out_dir(directory);
+    int extracted = 0;
+    for (int i = 0; i < entries_.size(); ++i) {
+        const QString& name = entries_.at(i).name;
+        if (IsPlainFileName(name) &&
+            ExtractTo(i, out_dir.filePath(name), xor_key_8_bytes)) {
+            ++extracted;
+        }
+    }
+    return extracted;
+}
+
+bool PackedContainerReader::Fail(const QString& message) {
+    error_string_ = message;
+    Close();
+    return false;
+}
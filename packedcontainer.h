@@ -0,0 +1,94 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+// Формат контейнера:
+//   "BOPK" | версия (u32) | данные записей подряд |
+//   индекс: на запись — длина имени (u32), имя (UTF-8), смещение (u64),
+//           длина (u64), CRC-32 данных (u32) |
+//   хвост: смещение индекса (u64), число записей (u32), "BOPX".
+// Все числа — little-endian.
+class PackedContainerWriter {
+public:
+    PackedContainerWriter() = default;
+    ~PackedContainerWriter();
+
+    // Создаёт новый файл; существующий не перезаписывается.
+    bool Open(const QString& path);
+    bool isOpen() const { return file_.isOpen(); }
+    QString path() const { return file_.fileName(); }
+    int entry_count() const { return entries_.size(); }
+
+    bool BeginEntry(const QString& name);
+    bool AppendData(const char* data, qint64 size);
+    bool EndEntry();
+    // Отбрасывает незавершённую запись; её данные перезапишет следующая.
+    void AbortEntry();
+
+    // Дописывает индекс и закрывает файл.
+    bool Finish();
+    // Закрывает и удаляет недописанный контейнер.
+    void Discard();
+
+private:
+    struct Entry {
+        QByteArray name;
+        qint64 offset = 0;
+        qint64 size = 0;
+        quint32 crc32 = 0;
+    };
+
+    QFile file_;
+    QVector<Entry> entries_;
+    Entry current_;
+    bool in_entry_ = false;
+    qint64 data_end_ = 0;
+};
+
+class PackedContainerReader {
+public:
+    struct Entry {
+        QString name;
+        qint64 offset = 0;
+        qint64 size = 0;
+        quint32 crc32 = 0;
+    };
+
+    PackedContainerReader() = default;
+    ~PackedContainerReader();
+
+    // Отображает контейнер в память и читает индекс.
+    bool Open(const QString& path);
+    void Close();
+    const QString& error_string() const { return error_string_; }
+
+    const QVector<Entry>& entries() const { return entries_; }
+    int IndexOf(const QString& name) const { return name_index_.value(name, -1); }
+
+    // Данные записи в том виде, в каком они лежат в контейнере (после XOR).
+    const char* EntryData(int index) const;
+    bool Verify(int index) const;
+
+    // Извлекает запись в файл; если задан ключ, снимает XOR.
+    bool ExtractTo(int index, const QString& path,
+                   const QByteArray& xor_key_8_bytes = QByteArray()) const;
+    // Записи с каталогами или ".." в имени пропускаются; возвращает
+    // число извлечённых.
+    int ExtractAll(const QString& directory,
+                   const QByteArray& xor_key_8_bytes = QByteArray()) const;
+
+private:
+    bool Fail(const QString& message);
+
+    QFile file_;
+    const uchar* map_ = nullptr;
+    qint64 map_size_ = 0;
+    QVector<Entry> entries_;
+    QHash<QString, int> name_index_;
+    QString error_string_;
+};
@@ -0,0 +1,195 @@
+#include "pendingqueue.h"
+
+#include "queuejournal.h"
+
+#include <QFileInfo>
+
+#include <algorithm>
+
+namespace {
+// Каждая секунда ожидания уменьшает эффективный размер файла на 1 МБ,
+// поэтому большие файлы не голодают при потоке мелких.
+constexpr double kAgingBytesPerSec = 1024.0 * 1024.0;
+}
+
+PendingQueue::PendingQueue() {
+    clock_.start();
+}
+
+int PendingQueue::Push(const QStringList& paths) {
+    QVector<QueueJournal::Entry> added;
+    for (const QString& path : paths) {
+        if (index_.contains(path) || IsExcluded(path)) {
+            continue;
+        }
+        QFileInfo info(path);
+        if (!info.exists()) {
+            continue;
+        }
+        Append(path, info.size());
+        added.append({path, info.size()});
+    }
+    if (journal_) {
+        journal_->LogAdded(added);
+    }
+    return added.size();
+}
+
+bool PendingQueue::Restore(const QString& path, qint64 size_bytes) {
+    if (index_.contains(path) || IsExcluded(path)) {
+        return false;
+    }
+    Append(path, size_bytes);
+    return true;
+}
+
+void PendingQueue::Append(const QString& path, qint64 size_bytes) {
+    Entry entry;
+    entry.path = path;
+    entry.size_bytes = size_bytes;
+    entry.enqueued_at_ms = clock_.elapsed();
+    entry.sequence = next_sequence_++;
+    entries_.append(entry);
+    index_.insert(path);
+    total_bytes_ += size_bytes;
+}
+
+bool PendingQueue::Contains(const QString& path) const {
+    return index_.contains(path);
+}
+
+int PendingQueue::RemoveMissing() {
+    QVector<Entry> valid;
+    valid.reserve(entries_.size());
+    int removed = 0;
+    for (const Entry& entry : entries_) {
+        if (QFileInfo::exists(entry.path)) {
+            valid.append(entry);
+        } else {
+            index_.remove(entry.path);
+            total_bytes_ -= entry.size_bytes;
+            if (journal_) {
+                journal_->LogRemoved(entry.path);
+            }
+            ++removed;
+        }
+    }
+    entries_ = std::move(valid);
+    return removed;
+}
+
+void PendingQueue::Clear() {
+    entries_.clear();
+    index_.clear();
+    total_bytes_ = 0;
+    if (journal_) {
+        journal_->LogCleared();
+    }
+}
+
+bool PendingQueue::HasWork(Lane lane) const {
+    for (const Entry& entry : entries_) {
+        if (InLane(entry, lane) && !IsExcluded(entry.path)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QStringList PendingQueue::TakeBatch(Lane lane, int max_files, qint64 max_bytes,
+                                    QVector<qint64>* sizes) {
+    const qint64 now_ms = clock_.elapsed();
+
+    QVector<int> candidates;
+    candidates.reserve(entries_.size());
+    for (int i = 0; i < entries_.size(); ++i) {
+        if (InLane(entries_.at(i), lane) && !IsExcluded(entries_.at(i).path)) {
+            candidates.append(i);
+        }
+    }
+    if (candidates.isEmpty()) {
+        return {};
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [this, now_ms](int a, int b) {
+                         return Score(entries_.at(a), now_ms) <
+                                Score(entries_.at(b), now_ms);
+                     });
+    if (max_files > 0 && candidates.size() > max_files) {
+        candidates.resize(max_files);
+    }
+    if (max_bytes > 0) {
+        qint64 batch_bytes = 0;
+        int count = 0;
+        while (count < candidates.size() && batch_bytes < max_bytes) {
+            batch_bytes += entries_.at(candidates.at(count)).size_bytes;
+            ++count;
+        }
+        candidates.resize(count);
+    }
+
+    QVector<bool> taken(entries_.size(), false);
+    QStringList batch;
+    batch.reserve(candidates.size());
+    for (int i : candidates) {
+        taken[i] = true;
+        batch.append(entries_.at(i).path);
+        if (sizes) {
+            sizes->append(entries_.at(i).size_bytes);
+        }
+        index_.remove(entries_.at(i).path);
+        total_bytes_ -= entries_.at(i).size_bytes;
+    }
+
+    QVector<Entry> rest;
+    rest.reserve(entries_.size() - candidates.size());
+    for (int i = 0; i < entries_.size(); ++i) {
+        if (!taken.at(i)) {
+            rest.append(entries_.at(i));
+        }
+    }
+    entries_ = std::move(rest);
+    if (journal_) {
+        journal_->LogTaken(batch);
+    }
+    return batch;
+}
+
+void PendingQueue::MarkDone(const QStringList& paths) {
+    if (journal_) {
+        journal_->LogDone(paths);
+    }
+}
+
+bool PendingQueue::InLane(const Entry& entry, Lane lane) const {
+    switch (lane) {
+    case Lane::kSmall:
+        return entry.size_bytes < small_file_threshold_;
+    case Lane::kLarge:
+        return entry.size_bytes >= small_file_threshold_;
+    case Lane::kAny:
+        break;
+    }
+    return true;
+}
+
+bool PendingQueue::IsExcluded(const QString& path) const {
+    return excluded_ && excluded_->contains(path);
+}
+
+double PendingQueue::Score(const Entry& entry, qint64 now_ms) const {
+    switch (policy_) {
+    case Settings::SchedulingPolicy::kShortestFirst:
+        return static_cast<double>(entry.size_bytes);
+    case Settings::SchedulingPolicy::kAging: {
+        const double age_sec = (now_ms - entry.enqueued_at_ms) / 1000.0;
+        return static_cast<double>(entry.size_bytes) -
+               age_sec * kAgingBytesPerSec;
+    }
+    case Settings::SchedulingPolicy::kFifo:
+    case Settings::SchedulingPolicy::kSizeLanes:
+        break;
+    }
+    return static_cast<double>(entry.sequence);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QtGlobal>
+
+#include "settings.h"
+
+class QueueJournal;
+
+class PendingQueue {
+public:
+    enum class Lane { kAny, kSmall, kLarge };
+
+    struct Entry {
+        QString path;
+        qint64 size_bytes = 0;
+        qint64 enqueued_at_ms = 0;
+        quint64 sequence = 0;
+    };
+
+    PendingQueue();
+
+    void SetPolicy(Settings::SchedulingPolicy policy) { policy_ = policy; }
+    Settings::SchedulingPolicy policy() const { return policy_; }
+
+    void SetSmallFileThreshold(qint64 bytes) { small_file_threshold_ = bytes; }
+    qint64 small_file_threshold() const { return small_file_threshold_; }
+
+    // Если журнал задан, все изменения очереди дописываются в него.
+    void SetJournal(QueueJournal* journal) { journal_ = journal; }
+    // Файлы из excluded ещё обрабатываются вне очереди: они не попадают
+    // в очередь и не выдаются в пакетах.
+    void SetExcluded(const QSet<QString>* excluded) { excluded_ = excluded; }
+
+    // Ставит в очередь файлы, которых в ней ещё нет; в журнал они
+    // уходят одной записью. Возвращает, сколько файлов добавлено.
+    int Push(const QStringList& paths);
+    // Возвращает в очередь файл из журнала, не обращаясь к диску.
+    bool Restore(const QString& path, qint64 size_bytes);
+    bool Contains(const QString& path) const;
+    int RemoveMissing();
+    void Clear();
+
+    int size() const { return entries_.size(); }
+    bool isEmpty() const { return entries_.isEmpty(); }
+    // Суммарный размер файлов в очереди.
+    qint64 bytes() const { return total_bytes_; }
+    bool HasWork(Lane lane) const;
+
+    // Извлекает до max_files файлов полосы lane в порядке текущей политики
+    // (max_files <= 0 — все подходящие файлы). Если max_bytes > 0, пакет
+    // заканчивается на файле, с которым набралось max_bytes. В sizes,
+    // если задан, — размеры файлов пакета.
+    QStringList TakeBatch(Lane lane, int max_files, qint64 max_bytes = 0,
+                          QVector<qint64>* sizes = nullptr);
+    // Отмечает выданные файлы обработанными.
+    void MarkDone(const QStringList& paths);
+
+private:
+    void Append(const QString& path, qint64 size_bytes);
+    bool InLane(const Entry& entry, Lane lane) const;
+    bool IsExcluded(const QString& path) const;
+    double Score(const Entry& entry, qint64 now_ms) const;
+
+    QVector<Entry> entries_;
+    QSet<QString> index_;
+    QElapsedTimer clock_;
+    QueueJournal* journal_ = nullptr;
+    const QSet<QString>* excluded_ = nullptr;
+    quint64 next_sequence_ = 0;
+    qint64 total_bytes_ = 0;
+    Settings::SchedulingPolicy policy_ = Settings::SchedulingPolicy::kFifo;
+    qint64 small_file_threshold_ = 1024 * 1024;
+};
@@ -0,0 +1,308 @@
+#include "queuejournal.h"
+
+#include "tracing.h"
+
+#include <QPair>
+#include <QSaveFile>
+
+#include <algorithm>
+
+namespace {
+// Версия 1 писала пути без экранирования; такой журнал ещё читается.
+const QByteArray kJournalVersion = "2";
+const QByteArray kUnescapedJournalVersion = "1";
+// Журнал переписывается, когда записей в нём во столько раз больше,
+// чем живых файлов в очереди, но не раньше kCompactMinRecords.
+constexpr qint64 kCompactGarbageFactor = 4;
+constexpr qint64 kCompactMinRecords = 64 * 1024;
+
+QByteArray EscapeField(const QString& field) {
+    const QByteArray utf8 = field.toUtf8();
+    QByteArray escaped;
+    escaped.reserve(utf8.size());
+    for (const char c : utf8) {
+        switch (c) {
+        case '\\': escaped.append("\\\\"); break;
+        case '\t': escaped.append("\\t"); break;
+        case '\n': escaped.append("\\n"); break;
+        default: escaped.append(c); break;
+        }
+    }
+    return escaped;
+}
+
+QString UnescapeField(const QByteArray& escaped) {
+    QByteArray utf8;
+    utf8.reserve(escaped.size());
+    for (int i = 0; i < escaped.size(); ++i) {
+        const char c = escaped.at(i);
+        if (c != '\\' || i + 1 == escaped.size()) {
+            utf8.append(c);
+            continue;
+        }
+        const char next = escaped.at(++i);
+        utf8.append(next == 't' ? '\t' : next == 'n' ? '\n' : next);
+    }
+    return QString::fromUtf8(utf8);
+}
+
+QByteArray Header(const QByteArray& version, const QString& job_id) {
+    return "H\t" + version + "\t" +
+           (version == kUnescapedJournalVersion ? job_id.toUtf8() : EscapeField(job_id));
+}
+
+QByteArray PathRecord(char type, const QString& path) {
+    QByteArray record;
+    record.append(type);
+    record.append('\t');
+    record.append(EscapeField(path));
+    record.append('\n');
+    return record;
+}
+
+QByteArray AddedRecord(const QString& path, qint64 size_bytes) {
+    QByteArray record = "A\t" + QByteArray::number(size_bytes) + "\t";
+    record.append(EscapeField(path));
+    record.append('\n');
+    return record;
+}
+}  // namespace
+
+QueueJournal::~QueueJournal() {
+    Close();
+}
+
+bool QueueJournal::Open(const QString& path, const QString& job_id) {
+    TRACE_SCOPE("QueueJournal::Open");
+    Close();
+    job_id_ = job_id;
+    live_.clear();
+    recovered_.clear();
+    next_sequence_ = 0;
+    file_.setFileName(path);
+
+    if (QFile::exists(path)) {
+        QFile in_file(path);
+        if (!in_file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        Replay(in_file.readAll());
+        in_file.close();
+    }
+
+    // Файлы, которые были у воркеров, не дошли до D: обрабатываем их
+    // первыми, остальные — в прежнем порядке.
+    QStringList order = LiveInOrder();
+    std::stable_partition(order.begin(), order.end(),
+                          [this](const QString& entry_path) {
+                              return live_.value(entry_path).in_flight;
+                          });
+    next_sequence_ = 0;
+    recovered_.reserve(order.size());
+    for (const QString& entry_path : order) {
+        LiveEntry& entry = live_[entry_path];
+        entry.in_flight = false;
+        entry.sequence = next_sequence_++;
+        recovered_.append({entry_path, entry.size_bytes});
+    }
+
+    return Compact();
+}
+
+void QueueJournal::Close() {
+    file_.close();
+}
+
+void QueueJournal::LogAdded(const QVector<Entry>& entries) {
+    if (!isOpen() || entries.isEmpty()) {
+        return;
+    }
+    QByteArray records;
+    for (const Entry& added : entries) {
+        LiveEntry& entry = live_[added.path];
+        entry.size_bytes = added.size_bytes;
+        entry.sequence = next_sequence_++;
+        entry.in_flight = false;
+        records.append(AddedRecord(added.path, added.size_bytes));
+    }
+    Append(records, entries.size());
+}
+
+void QueueJournal::LogTaken(const QStringList& paths) {
+    if (!isOpen() || paths.isEmpty()) {
+        return;
+    }
+    QByteArray records;
+    for (const QString& path : paths) {
+        auto it = live_.find(path);
+        if (it == live_.end()) {
+            LiveEntry entry;
+            entry.sequence = next_sequence_++;
+            live_.insert(path, entry);
+            it = live_.find(path);
+        }
+        it.value().in_flight = true;
+        records.append(PathRecord('T', path));
+    }
+    Append(records, paths.size());
+}
+
+void QueueJournal::LogDone(const QStringList& paths) {
+    if (!isOpen()) {
+        return;
+    }
+    QByteArray records;
+    int record_count = 0;
+    for (const QString& path : paths) {
+        if (live_.remove(path) > 0) {
+            records.append(PathRecord('D', path));
+            ++record_count;
+        }
+    }
+    if (record_count > 0) {
+        Append(records, record_count);
+    }
+}
+
+void QueueJournal::LogRemoved(const QString& path) {
+    if (!isOpen() || live_.remove(path) == 0) {
+        return;
+    }
+    Append(PathRecord('R', path), 1);
+}
+
+void QueueJournal::LogCleared() {
+    if (!isOpen()) {
+        return;
+    }
+    live_.clear();
+    Compact();
+}
+
+void QueueJournal::Replay(const QByteArray& contents) {
+    const QList<QByteArray> lines = contents.split('\n');
+    // Последний элемент — либо пустой хвост после '\n', либо строка,
+    // оборванная сбоем; в обоих случаях он не нужен.
+    const int complete_lines = lines.size() - 1;
+    if (complete_lines < 1) {
+        return;
+    }
+
+    bool escaped = true;
+    if (lines.at(0) != Header(kJournalVersion, job_id_)) {
+        if (lines.at(0) != Header(kUnescapedJournalVersion, job_id_)) {
+            return;
+        }
+        escaped = false;
+    }
+    auto decode_path = [escaped](const QByteArray& field) {
+        return escaped ? UnescapeField(field) : QString::fromUtf8(field);
+    };
+
+    for (int i = 1; i < complete_lines; ++i) {
+        const QByteArray& line = lines.at(i);
+        if (line.size() < 3 || line.at(1) != '\t') {
+            continue;
+        }
+        const QByteArray rest = line.mid(2);
+        switch (line.at(0)) {
+        case 'A': {
+            const int tab = rest.indexOf('\t');
+            bool ok = false;
+            const qint64 size_bytes = rest.left(tab).toLongLong(&ok);
+            if (tab < 0 || !ok) {
+                break;
+            }
+            LiveEntry& entry = live_[decode_path(rest.mid(tab + 1))];
+            entry.size_bytes = size_bytes;
+            entry.sequence = next_sequence_++;
+            entry.in_flight = false;
+            break;
+        }
+        case 'T': {
+            auto it = live_.find(decode_path(rest));
+            if (it != live_.end()) {
+                it.value().in_flight = true;
+            }
+            break;
+        }
+        case 'D':
+        case 'R':
+            live_.remove(decode_path(rest));
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+QStringList QueueJournal::LiveInOrder() const {
+    // Сортируются пары (номер, путь), а не пути: сравнение не ищет
+    // записи в live_.
+    QVector<QPair<quint64, QString>> numbered;
+    numbered.reserve(live_.size());
+    for (auto it = live_.constBegin(); it != live_.constEnd(); ++it) {
+        numbered.append(qMakePair(it.value().sequence, it.key()));
+    }
+    std::sort(numbered.begin(), numbered.end(),
+              [](const QPair<quint64, QString>& a, const QPair<quint64, QString>& b) {
+                  return a.first < b.first;
+              });
+    QStringList order;
+    order.reserve(numbered.size());
+    for (const auto& entry : numbered) {
+        order.append(entry.second);
+    }
+    return order;
+}
+
+void QueueJournal::Append(const QByteArray& records, int record_count) {
+    if (file_.write(records) != records.size() || !file_.flush()) {
+        // Без журнала очередь продолжает работать только в памяти.
+        Close();
+        return;
+    }
+    record_count_ += record_count;
+    MaybeCompact();
+}
+
+void QueueJournal::MaybeCompact() {
+    if (record_count_ >= kCompactMinRecords &&
+        record_count_ > kCompactGarbageFactor * (live_.size() + 1)) {
+        Compact();
+    }
+}
+
+bool QueueJournal::Compact() {
+    TRACE_SCOPE("QueueJournal::Compact");
+    file_.close();
+
+    // QSaveFile подменяет файл целиком только после записи, так что сбой
+    // во время сжатия оставляет старый журнал.
+    QSaveFile out_file(file_.fileName());
+    if (!out_file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    qint64 record_count = 1;
+    bool ok = out_file.write(Header(kJournalVersion, job_id_) + "\n") > 0;
+    for (const QString& path : LiveInOrder()) {
+        if (!ok) {
+            break;
+        }
+        const LiveEntry& entry = live_[path];
+        QByteArray records = AddedRecord(path, entry.size_bytes);
+        ++record_count;
+        if (entry.in_flight) {
+            records.append(PathRecord('T', path));
+            ++record_count;
+        }
+        ok = out_file.write(records) == records.size();
+    }
+    if (!ok || !out_file.commit()) {
+        out_file.cancelWriting();
+        return false;
+    }
+
+    record_count_ = record_count;
+    return file_.open(QIODevice::WriteOnly | QIODevice::Append);
+}
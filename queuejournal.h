@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QtGlobal>
+
+// Журнал очереди на диске: текстовые записи UTF-8, по одной в строке,
+// только дописываются.
+//   H\t<версия>\t<задание>  — заголовок (входная папка и маска);
+//   A\t<размер>\t<путь>     — файл поставлен в очередь;
+//   T\t<путь>               — файл выдан воркеру;
+//   D\t<путь>               — выход файла записан с надёжностью из
+//                            настроек (при Settings::Durability::kNone — без
+//                            сброса на диск);
+//   R\t<путь>               — файл убран из очереди без обработки.
+// В путях и задании обратная косая черта, табуляция и перевод строки
+// экранируются как \\, \t и \n: имя файла в Linux может содержать любой
+// из них.
+// При открытии журнал проигрывается и переписывается заново только с
+// живыми записями; то же происходит, когда мусора становится много.
+// Записи сбрасываются в ОС без fsync: журнал переживает падение процесса,
+// но при отключении питания его хвост может пропасть. Тогда выданные
+// файлы снова считаются ожидающими, а записи об уже удалённых входах
+// отбрасываются при восстановлении.
+class QueueJournal {
+public:
+    struct Entry {
+        QString path;
+        qint64 size_bytes = 0;
+    };
+
+    QueueJournal() = default;
+    ~QueueJournal();
+
+    // Восстанавливает очередь из path; журнал другого задания (job_id)
+    // или повреждённый заголовок начинаются с пустой очереди.
+    bool Open(const QString& path, const QString& job_id);
+    void Close();
+    bool isOpen() const { return file_.isOpen(); }
+
+    // Очередь на момент открытия: сначала файлы, что были у воркеров,
+    // затем ожидавшие — каждые в исходном порядке.
+    const QVector<Entry>& recovered() const { return recovered_; }
+
+    // Пакет файлов, поставленных в очередь, — одной записью в файл.
+    void LogAdded(const QVector<Entry>& entries);
+    void LogTaken(const QStringList& paths);
+    void LogDone(const QStringList& paths);
+    void LogRemoved(const QString& path);
+    void LogCleared();
+
+private:
+    struct LiveEntry {
+        qint64 size_bytes = 0;
+        quint64 sequence = 0;
+        bool in_flight = false;
+    };
+
+    void Replay(const QByteArray& contents);
+    QStringList LiveInOrder() const;
+    void Append(const QByteArray& records, int record_count);
+    void MaybeCompact();
+    bool Compact();
+
+    QFile file_;
+    QString job_id_;
+    QHash<QString, LiveEntry> live_;
+    QVector<Entry> recovered_;
+    quint64 next_sequence_ = 0;
+    qint64 record_count_ = 0;
+};
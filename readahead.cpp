@@ -0,0 +1,82 @@
+#include "readahead.h"
+
+#include "tracing.h"
+
+#include <QFile>
+
+#if defined(Q_OS_UNIX)
+#include <fcntl.h>
+#endif
+
+#include <climits>
+
+ReadAhead::ReadAhead(int max_files, qint64 budget_bytes)
+    : max_files_(max_files), budget_bytes_(budget_bytes) {
+}
+
+void ReadAhead::SetFiles(const QStringList& paths,
+                         const QVector<qint64>& sizes,
+                         qint64 skip_up_to_bytes) {
+    paths_ = paths;
+    sizes_ = sizes.size() == paths.size() ? sizes : QVector<qint64>();
+    skip_up_to_bytes_ = skip_up_to_bytes;
+    advised_bytes_ = QVector<qint64>(paths.size(), 0);
+    window_start_ = 0;
+    next_ = 0;
+    window_files_ = 0;
+    window_bytes_ = 0;
+}
+
+void ReadAhead::Advance(int index) {
+    if (max_files_ <= 0 || budget_bytes_ <= 0) {
+        return;
+    }
+    TRACE_SCOPE("ReadAhead::Advance");
+    // Начатые файлы читает сам воркер, дальше их ведёт обычное
+    // упреждающее чтение ядра.
+    for (; window_start_ <= index && window_start_ < next_; ++window_start_) {
+        const qint64 advised = advised_bytes_.at(window_start_);
+        if (advised >= 0) {
+            window_bytes_ -= advised;
+            --window_files_;
+        }
+    }
+    window_start_ = qMax(window_start_, index + 1);
+    next_ = qMax(next_, index + 1);
+
+    while (next_ < paths_.size() && window_files_ < max_files_ &&
+           window_bytes_ < budget_bytes_) {
+        if (!sizes_.isEmpty() && sizes_.at(next_) <= skip_up_to_bytes_) {
+            advised_bytes_[next_] = -1;
+            ++next_;
+            continue;
+        }
+        const qint64 advised = Advise(paths_.at(next_), budget_bytes_ - window_bytes_);
+        advised_bytes_[next_] = advised;
+        window_bytes_ += advised;
+        ++window_files_;
+        ++next_;
+    }
+}
+
+qint64 ReadAhead::Advise(const QString& path, qint64 max_bytes) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    const qint64 length = qMin(file.size(), max_bytes);
+    if (length <= 0) {
+        return 0;
+    }
+#if defined(Q_OS_MACOS)
+    radvisory advice;
+    advice.ra_offset = 0;
+    advice.ra_count = static_cast<int>(qMin<qint64>(length, INT_MAX));
+    return ::fcntl(file.handle(), F_RDADVISE, &advice) != -1 ? length : 0;
+#elif defined(Q_OS_UNIX)
+    return ::posix_fadvise(file.handle(), 0, length, POSIX_FADV_WILLNEED) == 0 ? length : 0;
+#else
+    // Без подсказок ОС файл просто будет прочитан с диска при открытии.
+    return 0;
+#endif
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QtGlobal>
+
+// Просит ОС заранее читать следующие файлы пакета, пока воркер занят
+// текущим, чтобы первое чтение нового файла не ждало диска.
+// Подсказки асинхронны: данные оседают в кэше страниц, а не в памяти
+// процесса.
+class ReadAhead {
+public:
+    // max_files <= 0 или budget_bytes <= 0 отключают подсказки.
+    ReadAhead(int max_files, qint64 budget_bytes);
+
+    // Файлы, которые по sizes не больше skip_up_to_bytes, не
+    // подсказываются: быстрый путь читает их одним вызовом, и открытие
+    // ради подсказки удвоило бы число открытий на файл. Пустой sizes —
+    // размеры неизвестны, подсказываются все файлы.
+    void SetFiles(const QStringList& paths,
+                  const QVector<qint64>& sizes = QVector<qint64>(),
+                  qint64 skip_up_to_bytes = 0);
+    // Вызывается перед обработкой файла index: подсказывает следующие
+    // за ним файлы, пока их не больше max_files и вместе не больше
+    // budget_bytes. От файла, не влезающего целиком, — начало.
+    void Advance(int index);
+
+private:
+    // Возвращает, сколько байт с начала файла подсказано.
+    static qint64 Advise(const QString& path, qint64 max_bytes);
+
+    int max_files_;
+    qint64 budget_bytes_;
+    QStringList paths_;
+    QVector<qint64> sizes_;
+    qint64 skip_up_to_bytes_ = 0;
+    // -1 — файл пропущен и не занимает места в окне.
+    QVector<qint64> advised_bytes_;
+    // Подсказанные, но ещё не начатые файлы: [window_start_, next_).
+    int window_start_ = 0;
+    int next_ = 0;
+    int window_files_ = 0;
+    qint64 window_bytes_ = 0;
+};
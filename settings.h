@@ -42,14 +42,152 @@ public:
     const QString& input_directory() const { return input_directory_; }
     void set_input_directory(const QString& value) { input_directory_ = value; }
 
+    enum class SchedulingPolicy { kFifo, kShortestFirst, kAging, kSizeLanes };
+    SchedulingPolicy scheduling_policy() const { return scheduling_policy_; }
+    void set_scheduling_policy(SchedulingPolicy value) {
+        scheduling_policy_ = value;
+    }
+
+    qint64 small_file_threshold_bytes() const {
+        return small_file_threshold_bytes_;
+    }
+    void set_small_file_threshold_bytes(qint64 value) {
+        small_file_threshold_bytes_ = value;
+    }
+
+    int batch_max_files() const { return batch_max_files_; }
+    void set_batch_max_files(int value) { batch_max_files_ = value; }
+
+    // Файлы не больше этого размера обрабатываются целиком за одно чтение,
+    // без пофайловых сообщений; 0 отключает быстрый путь.
+    qint64 small_file_fast_path_bytes() const {
+        return small_file_fast_path_bytes_;
+    }
+    void set_small_file_fast_path_bytes(qint64 value) {
+        small_file_fast_path_bytes_ = value;
+    }
+
+    qint64 buffer_pool_budget_bytes() const {
+        return buffer_pool_budget_bytes_;
+    }
+    void set_buffer_pool_budget_bytes(qint64 value) {
+        buffer_pool_budget_bytes_ = value;
+    }
+
+    bool use_huge_pages() const { return use_huge_pages_; }
+    void set_use_huge_pages(bool value) { use_huge_pages_ = value; }
+
+    // Список процессоров вида "0-3,8"; пустой — без ограничений.
+    const QString& cpu_set() const { return cpu_set_; }
+    void set_cpu_set(const QString& value) { cpu_set_ = value; }
+
+    bool pin_worker_threads() const { return pin_worker_threads_; }
+    void set_pin_worker_threads(bool value) { pin_worker_threads_ = value; }
+
+    // Лимиты ввода-вывода на все воркеры; 0 — без ограничения.
+    struct IoLimits {
+        qint64 read_bytes_per_sec = 0;
+        qint64 read_ops_per_sec = 0;
+        qint64 write_bytes_per_sec = 0;
+        qint64 write_ops_per_sec = 0;
+    };
+    const IoLimits& io_limits() const { return io_limits_; }
+    void set_io_limits(const IoLimits& value) { io_limits_ = value; }
+
+    // Если включено, лимиты действуют только с business_hours_start до
+    // business_hours_end (часы локального времени), в остальное время — нет.
+    bool io_limits_business_hours_only() const {
+        return io_limits_business_hours_only_;
+    }
+    void set_io_limits_business_hours_only(bool value) {
+        io_limits_business_hours_only_ = value;
+    }
+
+    int business_hours_start() const { return business_hours_start_; }
+    void set_business_hours_start(int value) { business_hours_start_ = value; }
+
+    int business_hours_end() const { return business_hours_end_; }
+    void set_business_hours_end(int value) { business_hours_end_ = value; }
+
+    enum class DedupMode { kOff, kHardLink, kReflink };
+    DedupMode dedup_mode() const { return dedup_mode_; }
+    void set_dedup_mode(DedupMode value) { dedup_mode_ = value; }
+
+    bool dedup_copy_fallback() const { return dedup_copy_fallback_; }
+    void set_dedup_copy_fallback(bool value) { dedup_copy_fallback_ = value; }
+
+    // kContainer — все файлы пакета дописываются в один контейнер
+    // (см. packedcontainer.h) вместо отдельных выходных файлов.
+    enum class OutputFormat { kFiles, kContainer };
+    OutputFormat output_format() const { return output_format_; }
+    void set_output_format(OutputFormat value) { output_format_ = value; }
+
+    // kPerFile — fsync каждого выхода; kGroupCommit — один сброс на
+    // group_commit_max_files файлов или раз в group_commit_interval_ms.
+    // Входы удаляются только после сброса их выходов.
+    enum class Durability { kNone, kPerFile, kGroupCommit };
+    Durability durability() const { return durability_; }
+    void set_durability(Durability value) { durability_ = value; }
+
+    int group_commit_max_files() const { return group_commit_max_files_; }
+    void set_group_commit_max_files(int value) { group_commit_max_files_ = value; }
+
+    int group_commit_interval_ms() const { return group_commit_interval_ms_; }
+    void set_group_commit_interval_ms(int value) {
+        group_commit_interval_ms_ = value;
+    }
+
+    // kCompress — после XOR выход сжимается кодеком сборки (см.
+    // streamcodec.h), к имени добавляется его расширение; kDecompress —
+    // обратный путь: вход распаковывается, затем XOR, расширение
+    // снимается. Действует только на вывод отдельными файлами.
+    enum class Compression { kOff, kCompress, kDecompress };
+    Compression compression() const { return compression_; }
+    void set_compression(Compression value) { compression_ = value; }
+
+    // Сколько следующих файлов пакета воркер просит ОС читать заранее
+    // и сколько байт с их начала вместе (0 — не просить).
+    int prefetch_files() const { return prefetch_files_; }
+    void set_prefetch_files(int value) { prefetch_files_ = value; }
+
+    qint64 prefetch_budget_bytes() const { return prefetch_budget_bytes_; }
+    void set_prefetch_budget_bytes(qint64 value) { prefetch_budget_bytes_ = value; }
+
+    // Очередь планировщика дублируется в журнал в выходной папке, и
+    // следующий запуск продолжает её без сканирования входной папки.
+    bool persistent_queue() const { return persistent_queue_; }
+    void set_persistent_queue(bool value) { persistent_queue_ = value; }
+
 private:
     QString input_directory_;
     QString input_file_mask_;
     QString output_directory_;
     QByteArray xor_key_8_bytes_;
+    QString cpu_set_;
     bool delete_input_files_ = false;
     OutputNameConflict output_name_conflict_ = OutputNameConflict::kOverwrite;
     RunMode run_mode_ = RunMode::kSingle;
     int run_interval_sec_ = 30;
     int check_files_interval_sec_ = 10;
+    SchedulingPolicy scheduling_policy_ = SchedulingPolicy::kFifo;
+    qint64 small_file_threshold_bytes_ = 1024 * 1024;
+    int batch_max_files_ = 0;
+    qint64 small_file_fast_path_bytes_ = 64 * 1024;
+    qint64 buffer_pool_budget_bytes_ = 64 * 1024 * 1024;
+    bool use_huge_pages_ = false;
+    bool pin_worker_threads_ = false;
+    IoLimits io_limits_;
+    bool io_limits_business_hours_only_ = false;
+    int business_hours_start_ = 9;
+    int business_hours_end_ = 18;
+    DedupMode dedup_mode_ = DedupMode::kOff;
+    bool dedup_copy_fallback_ = true;
+    OutputFormat output_format_ = OutputFormat::kFiles;
+    Durability durability_ = Durability::kNone;
+    int group_commit_max_files_ = 256;
+    int group_commit_interval_ms_ = 2000;
+    bool persistent_queue_ = false;
+    Compression compression_ = Compression::kOff;
+    int prefetch_files_ = 4;
+    qint64 prefetch_budget_bytes_ = 64 * 1024 * 1024;
 };
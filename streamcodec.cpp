@@ -0,0 +1,301 @@
+#include "streamcodec.h"
+
+#include "tracing.h"
+
+#include <cstring>
+
+#if defined(BINOPS_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+#if defined(BINOPS_HAVE_LZ4)
+#include <lz4frame.h>
+#endif
+
+namespace {
+// Уровни, при которых сжатие не отстаёт от записи на диск.
+constexpr int kZstdLevel = 1;
+constexpr int kLz4Level = 0;
+constexpr unsigned char kZstdMagic[] = {0x28, 0xB5, 0x2F, 0xFD};
+constexpr unsigned char kLz4Magic[] = {0x04, 0x22, 0x4D, 0x18};
+// Шаг роста выходного буфера при распаковке.
+constexpr qint64 kOutputStepBytes = 256 * 1024;
+
+bool HasMagic(const char* data, qint64 size, const unsigned char (&magic)[4]) {
+    return size >= 4 && std::memcmp(data, magic, 4) == 0;
+}
+}
+
+struct StreamCodec::State {
+    Codec codec = Codec::kNone;
+    bool compress = false;
+    // Распаковка: последний вызов закончил кадр.
+    bool frame_complete = false;
+#if defined(BINOPS_HAVE_ZSTD)
+    ZSTD_CCtx* zstd_cctx = nullptr;
+    ZSTD_DCtx* zstd_dctx = nullptr;
+#endif
+#if defined(BINOPS_HAVE_LZ4)
+    LZ4F_cctx* lz4_cctx = nullptr;
+    LZ4F_dctx* lz4_dctx = nullptr;
+    LZ4F_preferences_t lz4_preferences;
+    // Заголовок кадра LZ4 выдаётся вместе с первыми данными.
+    QByteArray lz4_header;
+#endif
+
+    ~State() {
+#if defined(BINOPS_HAVE_ZSTD)
+        ZSTD_freeCCtx(zstd_cctx);
+        ZSTD_freeDCtx(zstd_dctx);
+#endif
+#if defined(BINOPS_HAVE_LZ4)
+        LZ4F_freeCompressionContext(lz4_cctx);
+        LZ4F_freeDecompressionContext(lz4_dctx);
+#endif
+    }
+};
+
+StreamCodec::Codec StreamCodec::BuiltinCodec() {
+#if defined(BINOPS_HAVE_ZSTD)
+    return Codec::kZstd;
+#elif defined(BINOPS_HAVE_LZ4)
+    return Codec::kLz4;
+#else
+    return Codec::kNone;
+#endif
+}
+
+QString StreamCodec::FileSuffix(Codec codec) {
+    switch (codec) {
+    case Codec::kZstd:
+        return ".zst";
+    case Codec::kLz4:
+        return ".lz4";
+    case Codec::kNone:
+        break;
+    }
+    return QString();
+}
+
+StreamCodec::Codec StreamCodec::DetectCodec(const char* data, qint64 size) {
+#if defined(BINOPS_HAVE_ZSTD)
+    if (HasMagic(data, size, kZstdMagic)) {
+        return Codec::kZstd;
+    }
+#endif
+#if defined(BINOPS_HAVE_LZ4)
+    if (HasMagic(data, size, kLz4Magic)) {
+        return Codec::kLz4;
+    }
+#endif
+    Q_UNUSED(data);
+    Q_UNUSED(size);
+    return Codec::kNone;
+}
+
+StreamCodec::StreamCodec() = default;
+
+StreamCodec::~StreamCodec() = default;
+
+bool StreamCodec::BeginCompress(Codec codec, int threads) {
+    state_ = std::make_unique<State>();
+    state_->codec = codec;
+    state_->compress = true;
+    switch (codec) {
+#if defined(BINOPS_HAVE_ZSTD)
+    case Codec::kZstd:
+        state_->zstd_cctx = ZSTD_createCCtx();
+        if (!state_->zstd_cctx ||
+            ZSTD_isError(ZSTD_CCtx_setParameter(state_->zstd_cctx,
+                                                ZSTD_c_compressionLevel, kZstdLevel))) {
+            return false;
+        }
+        if (threads > 1) {
+            // Без поддержки потоков в libzstd параметр отвергается, и кадр
+            // сжимается в текущем потоке.
+            ZSTD_CCtx_setParameter(state_->zstd_cctx, ZSTD_c_nbWorkers, threads);
+        }
+        return true;
+#endif
+#if defined(BINOPS_HAVE_LZ4)
+    case Codec::kLz4: {
+        Q_UNUSED(threads);
+        if (LZ4F_isError(LZ4F_createCompressionContext(&state_->lz4_cctx, LZ4F_VERSION))) {
+            return false;
+        }
+        std::memset(&state_->lz4_preferences, 0, sizeof(state_->lz4_preferences));
+        state_->lz4_preferences.frameInfo.blockSizeID = LZ4F_max4MB;
+        state_->lz4_preferences.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+        state_->lz4_preferences.compressionLevel = kLz4Level;
+        state_->lz4_header.resize(LZ4F_HEADER_SIZE_MAX);
+        const size_t header_size =
+            LZ4F_compressBegin(state_->lz4_cctx, state_->lz4_header.data(),
+                               state_->lz4_header.size(), &state_->lz4_preferences);
+        if (LZ4F_isError(header_size)) {
+            return false;
+        }
+        state_->lz4_header.resize(static_cast<int>(header_size));
+        return true;
+    }
+#endif
+    default:
+        Q_UNUSED(threads);
+        return false;
+    }
+}
+
+bool StreamCodec::BeginDecompress(Codec codec) {
+    state_ = std::make_unique<State>();
+    state_->codec = codec;
+    state_->compress = false;
+    switch (codec) {
+#if defined(BINOPS_HAVE_ZSTD)
+    case Codec::kZstd:
+        state_->zstd_dctx = ZSTD_createDCtx();
+        return state_->zstd_dctx != nullptr;
+#endif
+#if defined(BINOPS_HAVE_LZ4)
+    case Codec::kLz4:
+        return !LZ4F_isError(
+            LZ4F_createDecompressionContext(&state_->lz4_dctx, LZ4F_VERSION));
+#endif
+    default:
+        return false;
+    }
+}
+
+bool StreamCodec::Update(const char* data, qint64 size, QByteArray* out,
+                         const std::function<bool()>& drain) {
+    TRACE_SCOPE("StreamCodec::Update");
+    if (!state_) {
+        return false;
+    }
+    switch (state_->codec) {
+#if defined(BINOPS_HAVE_ZSTD)
+    case Codec::kZstd: {
+        ZSTD_inBuffer input{data, static_cast<size_t>(size), 0};
+        const qint64 step = state_->compress
+            ? static_cast<qint64>(ZSTD_CStreamOutSize())
+            : kOutputStepBytes;
+        bool output_full = false;
+        while (input.pos < input.size || output_full) {
+            const int used = out->size();
+            out->resize(used + static_cast<int>(step));
+            ZSTD_outBuffer output{out->data() + used, static_cast<size_t>(step), 0};
+            const size_t result = state_->compress
+                ? ZSTD_compressStream2(state_->zstd_cctx, &output, &input, ZSTD_e_continue)
+                : ZSTD_decompressStream(state_->zstd_dctx, &output, &input);
+            out->resize(used + static_cast<int>(output.pos));
+            if (ZSTD_isError(result)) {
+                return false;
+            }
+            output_full = output.pos == output.size;
+            if (!state_->compress) {
+                state_->frame_complete = result == 0;
+            }
+            if (drain && out->size() >= kDrainBytes && !drain()) {
+                return false;
+            }
+        }
+        return true;
+    }
+#endif
+#if defined(BINOPS_HAVE_LZ4)
+    case Codec::kLz4: {
+        if (state_->compress) {
+            out->append(state_->lz4_header);
+            state_->lz4_header.clear();
+            const int used = out->size();
+            const size_t bound =
+                LZ4F_compressBound(static_cast<size_t>(size), &state_->lz4_preferences);
+            out->resize(used + static_cast<int>(bound));
+            const size_t written = LZ4F_compressUpdate(
+                state_->lz4_cctx, out->data() + used, bound, data,
+                static_cast<size_t>(size), nullptr);
+            if (LZ4F_isError(written)) {
+                out->resize(used);
+                return false;
+            }
+            out->resize(used + static_cast<int>(written));
+            return true;
+        }
+        qint64 consumed = 0;
+        bool output_full = false;
+        while (consumed < size || output_full) {
+            const int used = out->size();
+            out->resize(used + static_cast<int>(kOutputStepBytes));
+            size_t output_size = static_cast<size_t>(kOutputStepBytes);
+            size_t input_size = static_cast<size_t>(size - consumed);
+            const size_t result = LZ4F_decompress(state_->lz4_dctx, out->data() + used,
+                                                  &output_size, data + consumed,
+                                                  &input_size, nullptr);
+            out->resize(used + static_cast<int>(output_size));
+            if (LZ4F_isError(result)) {
+                return false;
+            }
+            consumed += static_cast<qint64>(input_size);
+            output_full = output_size == static_cast<size_t>(kOutputStepBytes);
+            state_->frame_complete = result == 0;
+            if (drain && out->size() >= kDrainBytes && !drain()) {
+                return false;
+            }
+        }
+        return true;
+    }
+#endif
+    default:
+        Q_UNUSED(data);
+        Q_UNUSED(size);
+        Q_UNUSED(out);
+        Q_UNUSED(drain);
+        return false;
+    }
+}
+
+bool StreamCodec::Finish(QByteArray* out) {
+    if (!state_) {
+        return false;
+    }
+    if (!state_->compress) {
+        return state_->frame_complete;
+    }
+    switch (state_->codec) {
+#if defined(BINOPS_HAVE_ZSTD)
+    case Codec::kZstd: {
+        ZSTD_inBuffer input{nullptr, 0, 0};
+        const qint64 step = static_cast<qint64>(ZSTD_CStreamOutSize());
+        size_t remaining = 1;
+        while (remaining != 0) {
+            const int used = out->size();
+            out->resize(used + static_cast<int>(step));
+            ZSTD_outBuffer output{out->data() + used, static_cast<size_t>(step), 0};
+            remaining = ZSTD_compressStream2(state_->zstd_cctx, &output, &input, ZSTD_e_end);
+            out->resize(used + static_cast<int>(output.pos));
+            if (ZSTD_isError(remaining)) {
+                return false;
+            }
+        }
+        return true;
+    }
+#endif
+#if defined(BINOPS_HAVE_LZ4)
+    case Codec::kLz4: {
+        out->append(state_->lz4_header);
+        state_->lz4_header.clear();
+        const int used = out->size();
+        const size_t bound = LZ4F_compressBound(0, &state_->lz4_preferences);
+        out->resize(used + static_cast<int>(bound));
+        const size_t written =
+            LZ4F_compressEnd(state_->lz4_cctx, out->data() + used, bound, nullptr);
+        if (LZ4F_isError(written)) {
+            out->resize(used);
+            return false;
+        }
+        out->resize(used + static_cast<int>(written));
+        return true;
+    }
+#endif
+    default:
+        Q_UNUSED(out);
+        return false;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+
+#include <functional>
+#include <memory>
+
+// Потоковое сжатие быстрым кодеком, найденным при сборке: zstd
+// (BINOPS_HAVE_ZSTD) или LZ4 frame (BINOPS_HAVE_LZ4). Каждый файл —
+// один кадр стандартного формата, читаемый утилитами zstd/lz4.
+class StreamCodec {
+public:
+    enum class Codec { kNone, kZstd, kLz4 };
+
+    // Кодек для сжатия в этой сборке; kNone — сжатие недоступно.
+    static Codec BuiltinCodec();
+    // Расширение выходного файла с точкой.
+    static QString FileSuffix(Codec codec);
+    // По первым байтам кадра; kNone — формат не распознан или не собран.
+    static Codec DetectCodec(const char* data, qint64 size);
+
+    StreamCodec();
+    ~StreamCodec();
+
+    // threads > 1 сжимает кадр в нескольких потоках (только zstd,
+    // собранный с поддержкой потоков; иначе — в одном).
+    bool BeginCompress(Codec codec, int threads);
+    bool BeginDecompress(Codec codec);
+    // Дописывает в out результат обработки очередных size байт. Если
+    // задан drain, он вызывается, когда out вырастает до kDrainBytes,
+    // и должен опустошить out (false — прервать): распаковка одного
+    // чанка может дать гигабайты.
+    bool Update(const char* data, qint64 size, QByteArray* out,
+                const std::function<bool()>& drain = nullptr);
+
+    static constexpr qint64 kDrainBytes = 4 * 1024 * 1024;
+    // Закрывает кадр при сжатии; при распаковке проверяет, что вход
+    // закончился на целом кадре.
+    bool Finish(QByteArray* out);
+
+private:
+    struct State;
+
+    std::unique_ptr<State> state_;
+};
@@ -1,112 +1,274 @@
 #include "taskscheduler.h"
+#include "cpuaffinity.h"
+#include "tracing.h"
 #include "worker.h"
 
+#include <QCryptographicHash>
+#include <QDir>
 #include <QFile>
-#include <QCoreApplication>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr qint64 kBytesPerMb = 1024 * 1024;
+const QString kQueueJournalFilePrefix = ".binops_queue_";
+// Пока активно несколько заданий, пакет ограничен этим объёмом, чтобы
+// воркер не уходил надолго на одно задание.
+constexpr qint64 kFairShareQuantumBytes = 64 * 1024 * 1024;
+// Накладные расходы на файл при учёте доли: иначе задание с миллионом
+// пустых файлов считалось бы бесплатным.
+constexpr qint64 kFairSharePerFileBytes = 64 * 1024;
+constexpr qint64 kEtaReportIntervalMs = 1000;
+}
 
 TaskScheduler::TaskScheduler(FileManager* file_manager, QObject* parent)
-    : QObject(parent),
-    file_manager_(file_manager),
-    run_timer_(std::make_unique<QTimer>(this)),
-    scan_timer_(std::make_unique<QTimer>(this)) {
-
-    connect(run_timer_.get(), &QTimer::timeout, this, &TaskScheduler::OnRunTimer);
-    connect(scan_timer_.get(), &QTimer::timeout, this, &TaskScheduler::OnScanTimer);
+    : QObject(parent) {
+    CreateJob(QString(), Settings(), 1, file_manager);
 }
 
 TaskScheduler::~TaskScheduler() {
     Stop();
-
+    ShutdownWorkerSlots();
+    ShutdownRetiredWorkers();
 }
 
 void TaskScheduler::SetSettings(const Settings& settings) {
-    settings_ = settings;
+    DefaultJob().settings = settings;
+}
+
+void TaskScheduler::UpdateIoLimits(const Settings& settings) {
+    Settings& pool_settings = DefaultJob().settings;
+    pool_settings.set_io_limits(settings.io_limits());
+    pool_settings.set_io_limits_business_hours_only(settings.io_limits_business_hours_only());
+    pool_settings.set_business_hours_start(settings.business_hours_start());
+    pool_settings.set_business_hours_end(settings.business_hours_end());
+    io_throttle_.Configure(pool_settings);
 }
 
 void TaskScheduler::Start() {
-    if (is_active_) {
-        return;
+    StartJob(kDefaultJobId);
+}
+
+bool TaskScheduler::StartJob(int job_id) {
+    Job* job = FindJob(job_id);
+    if (!job || job->is_active || job->remove_when_idle) {
+        return false;
     }
+    const Settings& settings = job->settings;
 
-    if (!file_manager_->IsValid()) {
-        emit ErrorOccurred("Не заданы входная папка или маска файлов.");
-        return;
+    if (!job->file_manager->IsValid()) {
+        emit ErrorOccurred(JobMessage(job_id, "Не заданы входная папка или маска файлов."));
+        return false;
     }
 
-    if (settings_.xor_key_8_bytes().size() != 8) {
-        emit ErrorOccurred("Ключ XOR должен быть 8 байт (16 hex-символов).");
-        return;
+    if (settings.xor_key_8_bytes().size() != 8) {
+        emit ErrorOccurred(JobMessage(job_id, "Ключ XOR должен быть 8 байт (16 hex-символов)."));
+        return false;
     }
 
-    if (settings_.output_directory().isEmpty()) {
-        emit ErrorOccurred("Не указана выходная папка.");
-        return;
+    if (settings.output_directory().isEmpty()) {
+        emit ErrorOccurred(JobMessage(job_id, "Не указана выходная папка."));
+        return false;
+    }
+
+    const Settings& pool_settings = DefaultJob().settings;
+    {
+        QMutexLocker locker(&queue_mutex_);
+        job->pending_files.SetJournal(nullptr);
+        job->pending_files.Clear();
+        job->pending_files.SetPolicy(settings.scheduling_policy());
+        job->pending_files.SetSmallFileThreshold(pool_settings.small_file_threshold_bytes());
     }
+    const int resumed = OpenQueueJournal(*job);
+    buffer_pool_.SetBudget(pool_settings.buffer_pool_budget_bytes());
+    buffer_pool_.SetUseHugePages(pool_settings.use_huge_pages());
+    io_throttle_.Configure(pool_settings);
+    // Выходы прошлого запуска могли быть сделаны с другим ключом.
+    job->dedup_cache.Clear();
+    ConfigureWorkerSlots();
+    if (!AnyJobActive()) {
+        ResetRunProgress();
+    }
+    job->is_active = true;
 
-    ClearQueue();
-    is_active_ = true;
+    emit StatusMessage(JobMessage(job_id, job_id == kDefaultJobId
+                                              ? "Планировщик запущен"
+                                              : "Задание запущено"));
 
-    emit StatusMessage("Планировщик запущен");
+    if (resumed > 0) {
+        emit StatusMessage(JobMessage(
+            job_id, QString("Продолжение очереди прошлого запуска: %1 файл(ов)").arg(resumed)));
+    }
 
-    if (settings_.run_mode() == Settings::RunMode::kSingle) {
-        QStringList files = file_manager_->GetInputFiles();
+    if (settings.run_mode() == Settings::RunMode::kSingle && resumed > 0) {
+        DispatchPending();
+    } else if (settings.run_mode() == Settings::RunMode::kSingle) {
+        QStringList files = job->file_manager->GetInputFiles();
         if (files.isEmpty()) {
-            emit StatusMessage("Нет файлов для обработки.");
-            emit SchedulerStopped();
-            is_active_ = false;
-            return;
+            emit StatusMessage(JobMessage(job_id, "Нет файлов для обработки."));
+            job->is_active = false;
+            emit JobFinished(job_id);
+            if (!AnyJobActive()) {
+                emit SchedulerStopped();
+            }
+            return true;
         }
 
-        emit StatusMessage(QString("Запущен разовый режим обработки: %1 файл(ов)").arg(files.size()));
-        StartWorkerWithList(files);
+        emit StatusMessage(JobMessage(
+            job_id, QString("Запущен разовый режим обработки: %1 файл(ов)").arg(files.size())));
+        {
+            QMutexLocker locker(&queue_mutex_);
+            job->pending_files.Push(files);
+        }
+        DispatchPending();
     } else {
-        emit StatusMessage("Запущен периодический режим");
+        emit StatusMessage(JobMessage(job_id, "Запущен периодический режим"));
 
-        QStringList initial_files = file_manager_->GetInputFiles();
-        if (!initial_files.isEmpty()) {
-            emit StatusMessage(QString("Немедленная обработка: %1 файл(ов)").arg(initial_files.size()));
-            StartWorkerWithList(initial_files);
+        QStringList initial_files;
+        if (resumed == 0) {
+            initial_files = job->file_manager->GetInputFiles();
+        }
+        // Новые файлы при продолжении очереди найдёт сканирование по таймеру.
+        if (resumed > 0) {
+            DispatchPending();
+        } else if (!initial_files.isEmpty()) {
+            emit StatusMessage(JobMessage(
+                job_id, QString("Немедленная обработка: %1 файл(ов)").arg(initial_files.size())));
+            {
+                QMutexLocker locker(&queue_mutex_);
+                job->pending_files.Push(initial_files);
+            }
+            DispatchPending();
         } else {
-            emit StatusMessage("Ожидание файлов...");
+            emit StatusMessage(JobMessage(job_id, "Ожидание файлов..."));
         }
 
-        StartTimersIfPeriodic();
+        StartTimersIfPeriodic(*job);
     }
 
     emit SchedulerStarted();
+    return true;
 }
 
 void TaskScheduler::Stop() {
-    if (!is_active_) {
+    if (!AnyJobActive()) {
         return;
     }
 
-    StopTimers();
-    is_active_ = false;
+    for (const auto& job : jobs_) {
+        StopJobTimers(*job);
+        if (job->is_active) {
+            job->is_active = false;
+            emit JobFinished(job->id);
+        }
+    }
 
-    if (worker_thread_ && worker_thread_->isRunning()) {
+    // Воркеры не ждём: отменённые пакеты дорабатывают в своих потоках,
+    // а новый запуск сразу получает свежие слоты.
+    if (AnyWorkerRunning()) {
         emit StopWorkerRequested();
         emit StatusMessage("Остановка обработки...");
-        worker_thread_->wait(3000);
+        for (size_t i = 0; i < worker_slots_.size(); ++i) {
+            if (worker_slots_[i].is_running) {
+                RetireWorkerSlot(i);
+            }
+        }
     }
 
     emit SchedulerStopped();
 }
 
+void TaskScheduler::StopJob(int job_id) {
+    Job* job = FindJob(job_id);
+    if (!job || !job->is_active) {
+        return;
+    }
+
+    StopJobTimers(*job);
+    job->is_active = false;
+    // Слоты задания сразу переходят к остальным заданиям, не дожидаясь
+    // отмены пакета.
+    bool retired = false;
+    for (size_t i = 0; i < worker_slots_.size(); ++i) {
+        if (worker_slots_[i].is_running && worker_slots_[i].job_id == job_id) {
+            RetireWorkerSlot(i);
+            retired = true;
+        }
+    }
+    if (retired && AnyJobActive()) {
+        // Остальные задания сразу получают новые воркеры слотов; при
+        // полной остановке привязку применит следующий запуск.
+        ApplyCpuAffinity();
+        DispatchPending();
+    }
+
+    emit StatusMessage(JobMessage(job_id, "Задание остановлено"));
+    emit JobFinished(job_id);
+    if (!AnyJobActive()) {
+        emit SchedulerStopped();
+    }
+}
+
 bool TaskScheduler::IsRunning() const {
-    return is_active_;
+    return AnyJobActive();
 }
 
-void TaskScheduler::AddFilesToQueue(const QStringList& files) {
-    QMutexLocker locker(&queue_mutex_);
+int TaskScheduler::AddJob(const QString& name, const Settings& settings, int weight) {
+    return CreateJob(name, settings, weight, nullptr)->id;
+}
 
-    int added = 0;
-    for (const QString& file : files) {
-        if (QFile::exists(file) && !pending_files_.contains(file)) {
-            pending_files_.append(file);
-            added++;
+void TaskScheduler::RemoveJob(int job_id) {
+    if (job_id == kDefaultJobId || !FindJob(job_id)) {
+        return;
+    }
+    StopJob(job_id);
+    if (JobHasRunningBatch(job_id)) {
+        // Воркер ещё пользуется FileManager и кэшем задания.
+        FindJob(job_id)->remove_when_idle = true;
+        return;
+    }
+    EraseJob(job_id);
+}
+
+void TaskScheduler::SetJobWeight(int job_id, int weight) {
+    if (Job* job = FindJob(job_id)) {
+        QMutexLocker locker(&queue_mutex_);
+        job->weight = qMax(1, weight);
+    }
+}
+
+bool TaskScheduler::IsJobRunning(int job_id) const {
+    const Job* job = FindJob(job_id);
+    return job && job->is_active;
+}
+
+QVector<int> TaskScheduler::job_ids() const {
+    QVector<int> ids;
+    for (const auto& job : jobs_) {
+        if (!job->remove_when_idle) {
+            ids.append(job->id);
         }
     }
+    return ids;
+}
+
+TaskScheduler::JobMetrics TaskScheduler::GetJobMetrics(int job_id) const {
+    const Job* job = FindJob(job_id);
+    if (!job) {
+        return {};
+    }
+    QMutexLocker locker(&queue_mutex_);
+    JobMetrics metrics = job->metrics;
+    metrics.pending_files = job->pending_files.size();
+    return metrics;
+}
+
+void TaskScheduler::AddFilesToQueue(const QStringList& files) {
+    QMutexLocker locker(&queue_mutex_);
+
+    const int added = DefaultJob().pending_files.Push(files);
 
     if (added > 0) {
         emit StatusMessage(QString("Добавлено %1 файл(ов) в очередь").arg(added));
@@ -115,7 +277,7 @@ void TaskScheduler::AddFilesToQueue(const QStringList& files) {
 
 void TaskScheduler::ClearQueue() {
     QMutexLocker locker(&queue_mutex_);
-    pending_files_.clear();
+    DefaultJob().pending_files.Clear();
 }
 
 void TaskScheduler::ProcessImmediately(const QStringList& files) {
@@ -123,152 +285,726 @@ void TaskScheduler::ProcessImmediately(const QStringList& files) {
         return;
     }
 
-    if (worker_is_running_) {
+    AddFilesToQueue(files);
+    if (DispatchPending() == 0 && AnyWorkerRunning()) {
         emit ErrorOccurred("Воркер занят, невозможно начать немедленную обработку");
-        AddFilesToQueue(files);
-        return;
     }
+}
 
-    StartWorkerWithList(files);
+TaskScheduler::Job* TaskScheduler::FindJob(int job_id) const {
+    for (const auto& job : jobs_) {
+        if (job->id == job_id) {
+            return job.get();
+        }
+    }
+    return nullptr;
 }
 
-void TaskScheduler::OnRunTimer() {
-    if (worker_is_running_) {
-        emit StatusMessage("Воркер занят, пропускаем цикл обработки.");
-        return;
+TaskScheduler::Job* TaskScheduler::CreateJob(const QString& name,
+                                             const Settings& settings,
+                                             int weight,
+                                             FileManager* file_manager) {
+    auto job = std::make_unique<Job>();
+    Job* raw_job = job.get();
+    raw_job->id = next_job_id_++;
+    raw_job->name = name;
+    raw_job->weight = qMax(1, weight);
+    raw_job->settings = settings;
+
+    if (!file_manager) {
+        raw_job->own_file_manager = std::make_unique<FileManager>();
+        raw_job->own_file_manager->SetInputDirectory(settings.input_directory());
+        raw_job->own_file_manager->SetOutputDirectory(settings.output_directory());
+        raw_job->own_file_manager->SetFileMask(settings.input_file_mask());
+        const int job_id = raw_job->id;
+        connect(raw_job->own_file_manager.get(), &FileManager::ErrorOccurred, this,
+                [this, job_id](const QString& message) {
+                    emit ErrorOccurred(JobMessage(job_id, message));
+                });
+        file_manager = raw_job->own_file_manager.get();
+    }
+    raw_job->file_manager = file_manager;
+
+    raw_job->run_timer = std::make_unique<QTimer>(this);
+    raw_job->scan_timer = std::make_unique<QTimer>(this);
+    connect(raw_job->run_timer.get(), &QTimer::timeout, this,
+            [this, raw_job]() { OnRunTimer(*raw_job); });
+    connect(raw_job->scan_timer.get(), &QTimer::timeout, this,
+            [this, raw_job]() { OnScanTimer(*raw_job); });
+
+    QMutexLocker locker(&queue_mutex_);
+    raw_job->pending_files.SetExcluded(&retired_files_);
+    jobs_.push_back(std::move(job));
+    return raw_job;
+}
+
+void TaskScheduler::EraseJob(int job_id) {
+    QMutexLocker locker(&queue_mutex_);
+    jobs_.erase(std::remove_if(jobs_.begin(), jobs_.end(),
+                               [job_id](const std::unique_ptr<Job>& job) {
+                                   return job->id == job_id;
+                               }),
+                jobs_.end());
+}
+
+bool TaskScheduler::AnyJobActive() const {
+    for (const auto& job : jobs_) {
+        if (job->is_active) {
+            return true;
+        }
     }
+    return false;
+}
 
-    QStringList to_process;
+bool TaskScheduler::JobHasRunningBatch(int job_id) const {
+    for (const WorkerSlot& slot : worker_slots_) {
+        if (slot.is_running && slot.job_id == job_id) {
+            return true;
+        }
+    }
+    for (const auto& retired : retired_workers_) {
+        if (retired->job_id == job_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::FinishJobIfDone(Job& job) {
+    if (!job.is_active || job.settings.run_mode() != Settings::RunMode::kSingle ||
+        JobHasRunningBatch(job.id)) {
+        return;
+    }
     {
         QMutexLocker locker(&queue_mutex_);
-        if (pending_files_.isEmpty()) {
+        if (!job.pending_files.isEmpty()) {
             return;
         }
-        to_process = pending_files_;
-        pending_files_.clear();
     }
 
-    if (!to_process.isEmpty()) {
-        emit StatusMessage(QString("Таймер обработки: запуск %1 файл(ов)").arg(to_process.size()));
-        StartWorkerWithList(to_process);
+    job.is_active = false;
+    const JobMetrics& metrics = job.metrics;
+    emit StatusMessage(JobMessage(
+        job.id, QString("Задание завершено: файлов %1, %2 МБ, время воркеров %3 с, ошибок %4")
+                    .arg(metrics.processed_files)
+                    .arg(metrics.processed_bytes / kBytesPerMb)
+                    .arg(metrics.busy_ms / 1000)
+                    .arg(metrics.errors)));
+    emit JobFinished(job.id);
+    if (!AnyJobActive()) {
+        emit SchedulerStopped();
     }
 }
 
-void TaskScheduler::OnScanTimer() {
-    emit StatusMessage("Сканирование входной папки...");
+QString TaskScheduler::JobMessage(int job_id, const QString& message) const {
+    const Job* job = FindJob(job_id);
+    if (jobs_.size() < 2 || !job || job->name.isEmpty()) {
+        return message;
+    }
+    return QString("[%1] %2").arg(job->name, message);
+}
 
-    if (!file_manager_->IsValid()) {
-        emit ErrorOccurred("Ошибка: не задана входная папка или маска.");
+void TaskScheduler::OnRunTimer(Job& job) {
+    TRACE_SCOPE("TaskScheduler::OnRunTimer");
+    bool has_idle_slot = false;
+    for (const WorkerSlot& slot : worker_slots_) {
+        if (!slot.is_running) {
+            has_idle_slot = true;
+            break;
+        }
+    }
+    if (!has_idle_slot) {
+        emit StatusMessage(JobMessage(job.id, "Воркер занят, пропускаем цикл обработки."));
+        return;
+    }
+
+    const int started = DispatchPending();
+    if (started > 0) {
+        emit StatusMessage(JobMessage(
+            job.id, QString("Таймер обработки: запуск %1 файл(ов)").arg(started)));
+    }
+}
+
+void TaskScheduler::OnScanTimer(Job& job) {
+    TRACE_SCOPE("TaskScheduler::OnScanTimer");
+    emit StatusMessage(JobMessage(job.id, "Сканирование входной папки..."));
+
+    if (!job.file_manager->IsValid()) {
+        emit ErrorOccurred(JobMessage(job.id, "Ошибка: не задана входная папка или маска."));
         return;
     }
 
-    QStringList current_files = file_manager_->GetInputFiles();
+    QStringList current_files = job.file_manager->GetInputFiles();
 
-    int added = 0, removed = 0;
+    int added = 0, removed = 0, total = 0;
     {
         QMutexLocker locker(&queue_mutex_);
 
-        QStringList valid_pending;
-        for (int i = 0; i < pending_files_.size(); ++i) {
-            const QString& f = pending_files_.at(i);
-            if (QFile::exists(f)) {
-                valid_pending.append(f);
-            } else {
-                removed++;
-            }
-        }
-        pending_files_ = valid_pending;
-
-        for (int i = 0; i < current_files.size(); ++i) {
-            const QString& f = current_files.at(i);
-            if (!pending_files_.contains(f)) {
-                pending_files_.append(f);
-                added++;
-            }
-        }
+        removed = job.pending_files.RemoveMissing();
+        added = job.pending_files.Push(current_files);
+        total = job.pending_files.size();
     }
 
     if (added > 0) {
-        emit StatusMessage(QString("Найдено новых файлов: %1").arg(added));
+        emit StatusMessage(JobMessage(job.id, QString("Найдено новых файлов: %1").arg(added)));
     }
     if (removed > 0) {
-        emit StatusMessage(QString("Удалено несуществующих файлов: %1").arg(removed));
+        emit StatusMessage(JobMessage(job.id, QString("Удалено несуществующих файлов: %1").arg(removed)));
     }
 
     if (added > 0 || removed > 0) {
+        emit StatusMessage(JobMessage(job.id, QString("Всего в очереди: %1 файл(ов)").arg(total)));
+    }
+}
+
+int TaskScheduler::OpenQueueJournal(Job& job) {
+    job.queue_journal.Close();
+    if (!job.settings.persistent_queue()) {
+        return 0;
+    }
+
+    // Задания могут писать в одну выходную папку, поэтому имя журнала
+    // зависит от входной папки и маски.
+    const QString job_key =
+        job.file_manager->input_directory() + '|' + job.file_manager->file_mask();
+    const QString file_name = kQueueJournalFilePrefix +
+        QString::fromLatin1(QCryptographicHash::hash(job_key.toUtf8(),
+                                                     QCryptographicHash::Md5)
+                                .toHex()
+                                .left(8));
+    const QString path = QDir(job.settings.output_directory()).filePath(file_name);
+    if (!job.queue_journal.Open(path, job_key)) {
+        emit ErrorOccurred(JobMessage(job.id, "Не удалось открыть журнал очереди: " + path));
+        return 0;
+    }
+
+    QMutexLocker locker(&queue_mutex_);
+    int restored = 0;
+    for (const QueueJournal::Entry& entry : job.queue_journal.recovered()) {
+        // Вход мог быть удалён до того, как в журнал попала его запись D.
+        if (!QFileInfo::exists(entry.path)) {
+            job.queue_journal.LogRemoved(entry.path);
+            continue;
+        }
+        if (job.pending_files.Restore(entry.path, entry.size_bytes)) {
+            ++restored;
+        }
+    }
+    job.pending_files.SetJournal(&job.queue_journal);
+    return restored;
+}
+
+void TaskScheduler::OnFilesCommitted(int job_id, const QStringList& input_paths,
+                                     bool remove_inputs) {
+    {
         QMutexLocker locker(&queue_mutex_);
-        emit StatusMessage(QString("Всего в очереди: %1 файл(ов)").arg(pending_files_.size()));
+        if (Job* job = FindJob(job_id)) {
+            job->pending_files.MarkDone(input_paths);
+        }
     }
+    if (remove_inputs) {
+        for (const QString& input_path : input_paths) {
+            QFile::remove(input_path);
+        }
+    }
+}
+
+void TaskScheduler::ConfigureWorkerSlots() {
+    if (AnyWorkerRunning()) {
+        return;
+    }
+
+    const Settings& pool_settings = DefaultJob().settings;
+    std::vector<PendingQueue::Lane> lanes;
+    if (pool_settings.scheduling_policy() == Settings::SchedulingPolicy::kSizeLanes) {
+        lanes = {PendingQueue::Lane::kSmall, PendingQueue::Lane::kLarge};
+    } else {
+        lanes = {PendingQueue::Lane::kAny};
+    }
+
+    bool same_layout = worker_slots_.size() == lanes.size();
+    for (size_t i = 0; same_layout && i < lanes.size(); ++i) {
+        same_layout = worker_slots_[i].lane == lanes[i];
+    }
+    // Новые потоки наследуют маску процесса, так что прежняя привязка
+    // снимается пересозданием слотов.
+    if (!same_layout || (affinity_applied_ && !WantsCpuAffinity())) {
+        ShutdownWorkerSlots();
+        affinity_applied_ = false;
+        for (PendingQueue::Lane lane : lanes) {
+            CreateWorkerSlot(lane);
+        }
+    }
+
+    ApplyCpuAffinity();
+}
+
+bool TaskScheduler::WantsCpuAffinity() const {
+    const Settings& pool_settings = DefaultJob().settings;
+    return !pool_settings.cpu_set().trimmed().isEmpty() ||
+           pool_settings.pin_worker_threads();
+}
+
+void TaskScheduler::ApplyCpuAffinity() {
+    if (!WantsCpuAffinity()) {
+        return;
+    }
+    const Settings& pool_settings = DefaultJob().settings;
+    QVector<int> allowed_cpus;
+    if (!pool_settings.cpu_set().trimmed().isEmpty()) {
+        allowed_cpus = CpuAffinity::ParseCpuList(pool_settings.cpu_set());
+        if (allowed_cpus.isEmpty()) {
+            emit ErrorOccurred("Некорректный список процессоров: " + pool_settings.cpu_set());
+            return;
+        }
+    } else {
+        allowed_cpus = CpuAffinity::AllCpus();
+    }
+    affinity_applied_ = true;
+
+    for (size_t i = 0; i < worker_slots_.size(); ++i) {
+        QVector<int> cpus = allowed_cpus;
+        if (pool_settings.pin_worker_threads()) {
+            cpus = {allowed_cpus.at(static_cast<int>(i % allowed_cpus.size()))};
+        }
+        Worker* worker = worker_slots_[i].worker.get();
+        QMetaObject::invokeMethod(
+            worker, [worker, cpus]() { worker->BindToCpus(cpus); },
+            Qt::QueuedConnection);
+    }
+}
+
+void TaskScheduler::CreateWorkerSlot(PendingQueue::Lane lane) {
+    worker_slots_.emplace_back();
+    worker_slots_.back().lane = lane;
+    InitWorkerSlot(worker_slots_.size() - 1);
+}
+
+void TaskScheduler::InitWorkerSlot(size_t slot_index) {
+    WorkerSlot& slot = worker_slots_[slot_index];
+    slot.thread = std::make_unique<QThread>();
+    slot.thread->setObjectName(QString("Worker %1").arg(slot_index));
+    slot.worker = std::make_unique<Worker>(DefaultJob().file_manager,
+                                           DefaultJob().settings,
+                                           &buffer_pool_, &io_throttle_,
+                                           nullptr, nullptr);
+    slot.worker->moveToThread(slot.thread.get());
+
+    Worker* worker = slot.worker.get();
+    connect(worker, &Worker::Finished, this,
+            [this, slot_index](int processed_files) {
+                OnWorkerFinished(slot_index, processed_files);
+            });
+    connect(worker, &Worker::BytesProcessed, this,
+            [this, slot_index](qint64 bytes) {
+                OnWorkerBytesProcessed(slot_index, bytes);
+            });
+    connect(worker, &Worker::FilesCommitted, this,
+            [this, slot_index](const QStringList& input_paths, bool remove_inputs) {
+                OnFilesCommitted(worker_slots_[slot_index].job_id, input_paths,
+                                 remove_inputs);
+            });
+    connect(worker, &Worker::ProgressFile, this, &TaskScheduler::ProgressFile);
+    connect(worker, &Worker::StatusMessage, this,
+            [this, slot_index](const QString& message) {
+                emit StatusMessage(JobMessage(worker_slots_[slot_index].job_id, message));
+            });
+    connect(worker, &Worker::ErrorOccurred, this,
+            [this, slot_index](const QString& message) {
+                const int job_id = worker_slots_[slot_index].job_id;
+                if (Job* job = FindJob(job_id)) {
+                    ++job->metrics.errors;
+                }
+                emit ErrorOccurred(JobMessage(job_id, message));
+            });
+    connect(this, &TaskScheduler::StopWorkerRequested, worker, &Worker::RequestCancel, Qt::DirectConnection);
+
+    slot.thread->start();
 }
 
-void TaskScheduler::StartWorkerWithList(const QStringList& files) {
+void TaskScheduler::RetireWorkerSlot(size_t slot_index) {
+    WorkerSlot& slot = worker_slots_[slot_index];
+    auto retired = std::make_unique<RetiredWorker>();
+    RetiredWorker* raw_retired = retired.get();
+    retired->worker = std::move(slot.worker);
+    retired->thread = std::move(slot.thread);
+    retired->job_id = slot.job_id;
+    retired->batch_files = slot.batch_files;
+    retired->batch_sizes = slot.batch_sizes;
+    retired->batch_timer = slot.batch_timer;
+    {
+        // Пока воркер дорабатывает пакет (сброс на диск, удаление входов),
+        // его файлы не должны попасть в новые пакеты.
+        QMutexLocker locker(&queue_mutex_);
+        for (const QString& path : retired->batch_files) {
+            retired_files_.insert(path);
+        }
+    }
+
+    Worker* worker = retired->worker.get();
+    worker->RequestCancel();
+    worker->disconnect(this);
+    disconnect(this, nullptr, worker, nullptr);
+
+    connect(worker, &Worker::Finished, this,
+            [this, raw_retired](int processed_files) {
+                OnRetiredWorkerFinished(raw_retired, processed_files);
+            });
+    connect(retired->thread.get(), &QThread::finished, this,
+            [this, raw_retired]() { OnRetiredThreadFinished(raw_retired); });
+    const int job_id = retired->job_id;
+    connect(worker, &Worker::FilesCommitted, this,
+            [this, job_id](const QStringList& input_paths, bool remove_inputs) {
+                OnFilesCommitted(job_id, input_paths, remove_inputs);
+            });
+    connect(worker, &Worker::StatusMessage, this,
+            [this, job_id](const QString& message) {
+                emit StatusMessage(JobMessage(job_id, message));
+            });
+    connect(worker, &Worker::ErrorOccurred, this,
+            [this, job_id](const QString& message) {
+                if (Job* job = FindJob(job_id)) {
+                    ++job->metrics.errors;
+                }
+                emit ErrorOccurred(JobMessage(job_id, message));
+            });
+    retired_workers_.push_back(std::move(retired));
+
+    slot.is_running = false;
+    slot.job_id = -1;
+    slot.batch_files.clear();
+    slot.batch_sizes.clear();
+    slot.batch_bytes = 0;
+    slot.done_bytes = 0;
+    InitWorkerSlot(slot_index);
+}
+
+void TaskScheduler::OnRetiredWorkerFinished(RetiredWorker* retired, int processed_files) {
+    Job* job = FindJob(retired->job_id);
+    if (job) {
+        job->metrics.processed_files += processed_files;
+        for (int i = 0; i < processed_files && i < retired->batch_sizes.size(); ++i) {
+            job->metrics.processed_bytes += retired->batch_sizes.at(i);
+        }
+        job->metrics.busy_ms += retired->batch_timer.elapsed();
+    }
+
+    int requeued = 0;
+    {
+        QMutexLocker locker(&queue_mutex_);
+        for (const QString& path : retired->batch_files) {
+            retired_files_.remove(path);
+        }
+        // Задание могли запустить снова, пока воркер дорабатывал: его
+        // необработанные файлы возвращаются в очередь.
+        if (job && job->is_active) {
+            requeued = job->pending_files.Push(retired->batch_files.mid(processed_files));
+        }
+    }
+    retired->batch_files.clear();
+    retired->thread->quit();
+    if (requeued > 0) {
+        DispatchPending();
+    }
+}
+
+void TaskScheduler::OnRetiredThreadFinished(RetiredWorker* retired) {
+    // finished приходит из самого потока перед его выходом.
+    retired->thread->wait();
+    const int job_id = retired->job_id;
+    retired_workers_.erase(
+        std::remove_if(retired_workers_.begin(), retired_workers_.end(),
+                       [retired](const std::unique_ptr<RetiredWorker>& entry) {
+                           return entry.get() == retired;
+                       }),
+        retired_workers_.end());
+
+    Job* job = FindJob(job_id);
+    if (job && job->remove_when_idle && !JobHasRunningBatch(job_id)) {
+        EraseJob(job_id);
+    } else if (job) {
+        FinishJobIfDone(*job);
+    }
+}
+
+void TaskScheduler::ShutdownWorkerSlots() {
+    for (WorkerSlot& slot : worker_slots_) {
+        if (slot.worker) {
+            slot.worker->RequestCancel();
+        }
+        if (slot.thread) {
+            slot.thread->quit();
+            slot.thread->wait();
+        }
+        if (slot.worker) {
+            slot.worker->disconnect();
+            slot.worker.reset();
+        }
+        slot.thread.reset();
+    }
+    worker_slots_.clear();
+}
+
+void TaskScheduler::ShutdownRetiredWorkers() {
+    for (const auto& retired : retired_workers_) {
+        retired->worker->RequestCancel();
+        retired->thread->disconnect(this);
+        retired->thread->quit();
+        retired->thread->wait();
+        retired->worker->disconnect();
+    }
+    retired_workers_.clear();
+}
+
+TaskScheduler::Job* TaskScheduler::PickJob(PendingQueue::Lane lane) {
+    Job* best = nullptr;
+    for (const auto& job : jobs_) {
+        if (!job->is_active || !job->pending_files.HasWork(lane)) {
+            continue;
+        }
+        job->virtual_time = qMax(job->virtual_time, system_virtual_time_);
+        if (!best || job->virtual_time < best->virtual_time) {
+            best = job.get();
+        }
+    }
+    return best;
+}
+
+int TaskScheduler::DispatchPending() {
+    TRACE_SCOPE("TaskScheduler::DispatchPending");
+    int started = 0;
+    for (size_t i = 0; i < worker_slots_.size(); ++i) {
+        if (worker_slots_[i].is_running) {
+            continue;
+        }
+
+        Job* job = nullptr;
+        QStringList batch;
+        QVector<qint64> sizes;
+        {
+            QMutexLocker locker(&queue_mutex_);
+            job = PickJob(worker_slots_[i].lane);
+            if (!job) {
+                continue;
+            }
+            int active_jobs = 0;
+            for (const auto& other : jobs_) {
+                active_jobs += other->is_active ? 1 : 0;
+            }
+            const qint64 quantum = active_jobs > 1 ? kFairShareQuantumBytes : 0;
+            batch = job->pending_files.TakeBatch(worker_slots_[i].lane,
+                                                 job->settings.batch_max_files(),
+                                                 quantum, &sizes);
+            if (batch.isEmpty()) {
+                continue;
+            }
+
+            qint64 cost = 0;
+            for (qint64 size : sizes) {
+                cost += size + kFairSharePerFileBytes;
+            }
+            system_virtual_time_ = job->virtual_time;
+            job->virtual_time += static_cast<double>(cost) / job->weight;
+        }
+
+        started += batch.size();
+        StartWorkerWithList(i, *job, batch, sizes);
+    }
+    return started;
+}
+
+bool TaskScheduler::AnyWorkerRunning() const {
+    for (const WorkerSlot& slot : worker_slots_) {
+        if (slot.is_running) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::StartWorkerWithList(size_t slot_index, Job& job,
+                                        const QStringList& files,
+                                        const QVector<qint64>& sizes) {
     if (files.isEmpty()) {
         return;
     }
 
-    if (worker_is_running_) {
+    WorkerSlot& slot = worker_slots_[slot_index];
+    if (slot.is_running) {
         emit ErrorOccurred("Попытка запустить воркер, когда он уже работает");
         return;
     }
 
-    worker_is_running_ = true;
+    slot.is_running = true;
+    slot.job_id = job.id;
+    slot.batch_files = files;
+    slot.batch_sizes = sizes;
+    slot.batch_timer.start();
+    slot.batch_bytes = 0;
+    for (qint64 size : sizes) {
+        slot.batch_bytes += size;
+    }
+    slot.done_bytes = 0;
+    ++job.metrics.batches;
+
+    Worker* worker = slot.worker.get();
+    const Settings settings = job.settings;
+    FileManager* file_manager = job.file_manager;
+    DedupCache* dedup_cache = &job.dedup_cache;
+    // Воркеры слотов могут сжимать одновременно.
+    const int codec_threads = qMax(
+        1, QThread::idealThreadCount() / static_cast<int>(worker_slots_.size()));
+    worker->MarkBusy();
+    QMetaObject::invokeMethod(
+        worker,
+        [worker, files, sizes, settings, file_manager, dedup_cache, codec_threads]() {
+            worker->SetSettings(settings);
+            worker->SetFileManager(file_manager);
+            worker->SetDedupCache(dedup_cache);
+            worker->SetCodecThreads(codec_threads);
+            worker->SetFilesToProcess(files, sizes);
+            worker->Process();
+        },
+        Qt::QueuedConnection);
+}
 
-    worker_thread_ = std::make_unique<QThread>();
-    worker_ = std::make_unique<Worker>(file_manager_, settings_, nullptr);
-    worker_->SetFilesToProcess(files);
-    worker_->moveToThread(worker_thread_.get());
+void TaskScheduler::StartTimersIfPeriodic(Job& job) {
+    const Settings& settings = job.settings;
+    if (settings.run_mode() != Settings::RunMode::kPeriodic) {
+        return;
+    }
 
-    connect(worker_thread_.get(), &QThread::started, worker_.get(), &Worker::Process);
-    connect(worker_.get(), &Worker::Finished, worker_thread_.get(), &QThread::quit);
-    connect(worker_.get(), &Worker::Finished, this, &TaskScheduler::OnWorkerFinished);
-    connect(worker_.get(), &Worker::ProgressOverall, this, &TaskScheduler::ProgressOverall);
-    connect(worker_.get(), &Worker::ProgressFile, this, &TaskScheduler::ProgressFile);
-    connect(worker_.get(), &Worker::StatusMessage, this, &TaskScheduler::StatusMessage);
-    connect(worker_.get(), &Worker::ErrorOccurred, this, &TaskScheduler::ErrorOccurred);
-    connect(this, &TaskScheduler::StopWorkerRequested, worker_.get(), &Worker::RequestCancel, Qt::QueuedConnection);
+    job.run_timer->setInterval(settings.run_interval_sec() * 1000);
+    job.run_timer->start();
+
+    job.scan_timer->setInterval(settings.check_files_interval_sec() * 1000);
+    job.scan_timer->start();
+
+    emit StatusMessage(JobMessage(
+        job.id, QString("Таймеры запущены: обработка каждые %1 сек, сканирование каждые %2 сек")
+                    .arg(settings.run_interval_sec())
+                    .arg(settings.check_files_interval_sec())));
+}
 
-    worker_thread_->start();
+void TaskScheduler::StopJobTimers(Job& job) {
+    if (job.run_timer) job.run_timer->stop();
+    if (job.scan_timer) job.scan_timer->stop();
 }
 
-void TaskScheduler::StartTimersIfPeriodic() {
-    if (settings_.run_mode() != Settings::RunMode::kPeriodic) {
+void TaskScheduler::OnWorkerFinished(size_t slot_index, int processed_files) {
+    TRACE_SCOPE("TaskScheduler::OnWorkerFinished");
+    if (slot_index >= worker_slots_.size()) {
         return;
     }
+    WorkerSlot& slot = worker_slots_[slot_index];
+    if (slot.worker && slot.worker->IsBusy()) {
+        // Устаревшее уведомление: слоту уже выдан следующий пакет.
+        return;
+    }
+    slot.is_running = false;
+
+    // Воркер идёт по пакету по порядку, поэтому обработаны первые
+    // processed_files файлов.
+    Job* job = FindJob(slot.job_id);
+    if (job) {
+        job->metrics.processed_files += processed_files;
+        for (int i = 0; i < processed_files && i < slot.batch_sizes.size(); ++i) {
+            job->metrics.processed_bytes += slot.batch_sizes.at(i);
+        }
+        job->metrics.busy_ms += slot.batch_timer.elapsed();
+    }
+    slot.batch_files.clear();
+    slot.batch_sizes.clear();
+    slot.batch_bytes = 0;
+    slot.done_bytes = 0;
 
-    run_timer_->setInterval(settings_.run_interval_sec() * 1000);
-    run_timer_->start();
+    if (AnyJobActive()) {
+        DispatchPending();
+    }
+    ReportProgress();
+    if (job && job->remove_when_idle && !JobHasRunningBatch(job->id)) {
+        EraseJob(job->id);
+        job = nullptr;
+    }
+    if (job) {
+        FinishJobIfDone(*job);
+    }
+    if (AnyWorkerRunning()) {
+        return;
+    }
 
-    scan_timer_->setInterval(settings_.check_files_interval_sec() * 1000);
-    scan_timer_->start();
+    emit StatusMessage(QString("Память буферов: %1 МБ, пик %2 МБ")
+                           .arg(buffer_pool_.current_bytes() / kBytesPerMb)
+                           .arg(buffer_pool_.peak_bytes() / kBytesPerMb));
 
-    emit StatusMessage(QString("Таймеры запущены: обработка каждые %1 сек, сканирование каждые %2 сек")
-                           .arg(settings_.run_interval_sec())
-                           .arg(settings_.check_files_interval_sec()));
+    if (AnyJobActive()) {
+        // Цикл периодического режима закончен: следующий считает процент
+        // и скорость заново, а не вместе с уже обработанными байтами.
+        if (!AnyPendingFiles()) {
+            ResetRunProgress();
+        }
+        emit StatusMessage("Ожидание следующего цикла...");
+    }
 }
 
-void TaskScheduler::StopTimers() {
-    if (run_timer_) run_timer_->stop();
-    if (scan_timer_) scan_timer_->stop();
+bool TaskScheduler::AnyPendingFiles() const {
+    QMutexLocker locker(&queue_mutex_);
+    for (const auto& job : jobs_) {
+        if (job->is_active && !job->pending_files.isEmpty()) {
+            return true;
+        }
+    }
+    return false;
 }
 
-void TaskScheduler::OnWorkerFinished() {
-    worker_is_running_ = false;
+void TaskScheduler::ResetRunProgress() {
+    run_done_bytes_ = 0;
+    last_progress_percent_ = -1;
+    eta_report_timer_.invalidate();
+    throughput_.Reset();
+}
+
+void TaskScheduler::OnWorkerBytesProcessed(size_t slot_index, qint64 bytes) {
+    worker_slots_[slot_index].done_bytes += bytes;
+    run_done_bytes_ += bytes;
+    throughput_.Add(bytes);
+    ReportProgress();
+}
 
-    if (worker_) {
-        worker_->disconnect();
-        worker_.reset();
+void TaskScheduler::ReportProgress() {
+    qint64 remaining = 0;
+    {
+        QMutexLocker locker(&queue_mutex_);
+        for (const auto& job : jobs_) {
+            if (job->is_active) {
+                remaining += job->pending_files.bytes();
+            }
+        }
+    }
+    for (const WorkerSlot& slot : worker_slots_) {
+        if (slot.is_running) {
+            remaining += qMax<qint64>(0, slot.batch_bytes - slot.done_bytes);
+        }
     }
 
-    if (worker_thread_) {
-        worker_thread_->quit();
-        worker_thread_->wait();
-        worker_thread_.reset();
+    const qint64 total = run_done_bytes_ + remaining;
+    const int percent = total > 0 ? static_cast<int>(100 * run_done_bytes_ / total) : 100;
+    if (percent != last_progress_percent_) {
+        last_progress_percent_ = percent;
+        emit ProgressOverall(percent);
     }
 
-    if (settings_.run_mode() == Settings::RunMode::kPeriodic && is_active_) {
-        emit StatusMessage("Ожидание следующего цикла...");
-    } else if (settings_.run_mode() == Settings::RunMode::kSingle) {
-        is_active_ = false;
-        emit SchedulerStopped();
+    if (remaining > 0 && eta_report_timer_.isValid() &&
+        eta_report_timer_.elapsed() < kEtaReportIntervalMs) {
+        return;
+    }
+    eta_report_timer_.start();
+    const double rate = throughput_.bytes_per_sec();
+    if (remaining == 0) {
+        emit EstimatedTimeLeft(0);
+    } else if (rate > 0) {
+        emit EstimatedTimeLeft(static_cast<qint64>(std::ceil(remaining / rate)));
+    } else {
+        emit EstimatedTimeLeft(-1);
     }
 }
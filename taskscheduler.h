@@ -1,37 +1,86 @@
 #pragma once
 
+#include <QElapsedTimer>
 #include <QObject>
+#include <QSet>
 #include <QStringList>
 #include <QTimer>
 #include <QThread>
 #include <QMutex>
+#include <QVector>
 #include <memory>
+#include <vector>
 
+#include "bufferpool.h"
+#include "dedupcache.h"
 #include "filemanager.h"
+#include "iothrottle.h"
+#include "pendingqueue.h"
+#include "queuejournal.h"
 #include "settings.h"
+#include "throughputmeter.h"
 
 class Worker;
 
+// Планировщик ведёт несколько заданий (своя папка, маска, ключ, выход,
+// режим запуска) на общем пуле воркеров, буферов и лимитов ввода-вывода.
+// Воркеры делятся между заданиями пропорционально весам.
 class TaskScheduler : public QObject {
     Q_OBJECT
 
 public:
+    // Задание, которым управляют SetSettings/Start; его настройки задают
+    // и общий пул (политика, процессоры, буферы, лимиты).
+    static constexpr int kDefaultJobId = 0;
+
+    struct JobMetrics {
+        int pending_files = 0;
+        qint64 processed_files = 0;
+        qint64 processed_bytes = 0;
+        qint64 batches = 0;
+        qint64 errors = 0;
+        // Суммарное время воркеров на пакетах задания.
+        qint64 busy_ms = 0;
+    };
+
     explicit TaskScheduler(FileManager* file_manager,
                            QObject* parent = nullptr);
     ~TaskScheduler() override;
 
     void SetSettings(const Settings& settings);
+    // Применяет лимиты ввода-вывода из settings сразу, в том числе к
+    // уже идущей обработке.
+    void UpdateIoLimits(const Settings& settings);
     void Start();
+    // Останавливает все задания.
     void Stop();
+    // true, пока активно хотя бы одно задание.
     bool IsRunning() const;
 
+    // Входная папка и маска берутся из settings. weight >= 1.
+    int AddJob(const QString& name, const Settings& settings, int weight = 1);
+    void RemoveJob(int job_id);
+    void SetJobWeight(int job_id, int weight);
+    bool StartJob(int job_id);
+    void StopJob(int job_id);
+    bool IsJobRunning(int job_id) const;
+    QVector<int> job_ids() const;
+    JobMetrics GetJobMetrics(int job_id) const;
+    // Скорость обработки по последнему замеру, байт в секунду; 0, если
+    // обработка ещё не запускалась.
+    double measured_bytes_per_sec() const { return throughput_.last_bytes_per_sec(); }
+
 signals:
+    // Доля обработанных байт среди всех файлов активных заданий.
     void ProgressOverall(int percent);
+    // Оценка по текущей скорости; -1 — скорость ещё не измерена.
+    void EstimatedTimeLeft(qint64 seconds);
     void ProgressFile(const QString& file_name, int percent);
     void StatusMessage(const QString& message);
     void ErrorOccurred(const QString& message);
     void SchedulerStarted();
     void SchedulerStopped();
+    void JobFinished(int job_id);
 
     void StopWorkerRequested();
 
@@ -40,28 +89,121 @@ public slots:
     void ClearQueue();
     void ProcessImmediately(const QStringList& files);
 
-private slots:
-    void OnWorkerFinished();
-    void OnRunTimer();
-    void OnScanTimer();
-
 private:
-    void StartWorkerWithList(const QStringList& files);
-    void StartTimersIfPeriodic();
-    void StopTimers();
-
-    FileManager* file_manager_;
-    Settings settings_;
+    struct Job {
+        int id = 0;
+        QString name;
+        int weight = 1;
+        Settings settings;
+        FileManager* file_manager = nullptr;
+        std::unique_ptr<FileManager> own_file_manager;
+        PendingQueue pending_files;
+        QueueJournal queue_journal;
+        // Выходы разных заданий сделаны разными ключами и не взаимозаменяемы.
+        DedupCache dedup_cache;
+        std::unique_ptr<QTimer> run_timer;
+        std::unique_ptr<QTimer> scan_timer;
+        bool is_active = false;
+        bool remove_when_idle = false;
+        // Выданный объём работы, делённый на вес; следующий пакет получает
+        // задание с наименьшим значением.
+        double virtual_time = 0;
+        JobMetrics metrics;
+    };
+
+    // Поток и воркер слота живут между пакетами; пакеты передаются
+    // через очередь событий потока.
+    struct WorkerSlot {
+        PendingQueue::Lane lane = PendingQueue::Lane::kAny;
+        std::unique_ptr<Worker> worker;
+        std::unique_ptr<QThread> thread;
+        bool is_running = false;
+        int job_id = -1;
+        QStringList batch_files;
+        QVector<qint64> batch_sizes;
+        QElapsedTimer batch_timer;
+        qint64 batch_bytes = 0;
+        qint64 done_bytes = 0;
+    };
+
+    // Воркер, снятый со слота при остановке: дорабатывает отменённый пакет
+    // в своём потоке, а слот тем временем получает новый воркер.
+    struct RetiredWorker {
+        std::unique_ptr<Worker> worker;
+        std::unique_ptr<QThread> thread;
+        int job_id = -1;
+        QStringList batch_files;
+        QVector<qint64> batch_sizes;
+        QElapsedTimer batch_timer;
+    };
+
+    Job* FindJob(int job_id) const;
+    Job& DefaultJob() const { return *jobs_.front(); }
+    Job* CreateJob(const QString& name, const Settings& settings, int weight,
+                   FileManager* file_manager);
+    // Удаляет задание; у него не должно быть выданных пакетов.
+    void EraseJob(int job_id);
+    bool AnyJobActive() const;
+    bool JobHasRunningBatch(int job_id) const;
+    void FinishJobIfDone(Job& job);
+    void StopJobTimers(Job& job);
+    void OnRunTimer(Job& job);
+    void OnScanTimer(Job& job);
+    QString JobMessage(int job_id, const QString& message) const;
+
+    // Открывает журнал очереди задания и возвращает число восстановленных файлов.
+    int OpenQueueJournal(Job& job);
+    // Отмечает файлы в журнале задания и только затем удаляет входы.
+    void OnFilesCommitted(int job_id, const QStringList& input_paths,
+                          bool remove_inputs);
+    void ConfigureWorkerSlots();
+    void CreateWorkerSlot(PendingQueue::Lane lane);
+    void InitWorkerSlot(size_t slot_index);
+    // Отменяет пакет слота, не дожидаясь воркера, и ставит в слот новый.
+    void RetireWorkerSlot(size_t slot_index);
+    void OnRetiredWorkerFinished(RetiredWorker* retired, int processed_files);
+    void OnRetiredThreadFinished(RetiredWorker* retired);
+    void ShutdownWorkerSlots();
+    void ShutdownRetiredWorkers();
+    // Привязка нужна, только если задан список процессоров или
+    // закрепление воркеров; иначе потоки остаются с маской процесса.
+    bool WantsCpuAffinity() const;
+    void ApplyCpuAffinity();
+    // Вызывается под queue_mutex_.
+    Job* PickJob(PendingQueue::Lane lane);
+    int DispatchPending();
+    bool AnyWorkerRunning() const;
+    void StartWorkerWithList(size_t slot_index, Job& job,
+                             const QStringList& files,
+                             const QVector<qint64>& sizes);
+    void OnWorkerFinished(size_t slot_index, int processed_files);
+    void OnWorkerBytesProcessed(size_t slot_index, qint64 bytes);
+    void ReportProgress();
+    bool AnyPendingFiles() const;
+    void ResetRunProgress();
+    void StartTimersIfPeriodic(Job& job);
+
+    BufferPool buffer_pool_;
+    IoThrottle io_throttle_;
+
+    std::vector<std::unique_ptr<Job>> jobs_;
+    int next_job_id_ = kDefaultJobId;
+    // Виртуальное время последнего выданного пакета: задание, простаивавшее
+    // без файлов, не накапливает кредит сверх него.
+    double system_virtual_time_ = 0;
+
+    std::vector<WorkerSlot> worker_slots_;
+    // Потоки слотов привязаны к процессорам; снять привязку можно, только
+    // пересоздав их.
+    bool affinity_applied_ = false;
+    ThroughputMeter throughput_;
+    // Байты, обработанные с момента, когда пул начал работу после простоя.
+    qint64 run_done_bytes_ = 0;
+    int last_progress_percent_ = -1;
+    QElapsedTimer eta_report_timer_;
+    std::vector<std::unique_ptr<RetiredWorker>> retired_workers_;
+    // Файлы пакетов снятых воркеров до их Finished; под queue_mutex_.
+    QSet<QString> retired_files_;
 
-    std::unique_ptr<Worker> worker_;
-    std::unique_ptr<QThread> worker_thread_;
-
-    std::unique_ptr<QTimer> run_timer_;
-    std::unique_ptr<QTimer> scan_timer_;
-
-    QStringList pending_files_;
     mutable QMutex queue_mutex_;
-
-    bool is_active_ = false;
-    bool worker_is_running_ = false;
 };
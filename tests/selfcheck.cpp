@@ -0,0 +1,403 @@
+#include "selfcheck.h"
+
+#include "fileprocessor.h"
+#include "packedcontainer.h"
+#include "streamcodec.h"
+#include "tracing.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QTemporaryDir>
+
+#include <algorithm>
+
+namespace {
+const QString kKernelEngine = "XorChunk";
+const QString kReferenceEngine = "Эталон XOR";
+const QString kProcessFileEngine = "ProcessFile";
+const QString kSmallFileEngine = "ProcessSmallFile";
+const QString kContainerEngine = "ProcessFileToContainer";
+const QString kCodecEngine = "CompressFile/DecompressFile";
+
+constexpr int kKernelCases = 512;
+constexpr qint64 kMaxKernelCaseBytes = 64 * 1024;
+// Запас вокруг буфера ядра: запись за его границы испортит запас.
+constexpr int kGuardBytes = 16;
+constexpr qint64 kSmallFileLimit = 2 * FileProcessor::kChunkSizeBytes;
+constexpr int kRandomFileCases = 4;
+constexpr qint64 kBenchmarkBytes = 64 * 1024 * 1024;
+constexpr int kSmallBenchmarkFiles = 2000;
+constexpr qint64 kSmallBenchmarkFileBytes = 4 * 1024;
+constexpr double kBytesPerMb = 1024 * 1024;
+
+// Эталон: каждый байт файла по смещению i XOR-ится с байтом ключа i % 8.
+void ReferenceXor(char* data, qint64 size, const QByteArray& key, qint64 key_phase) {
+    for (qint64 i = 0; i < size; ++i) {
+        data[i] = static_cast<char>(data[i] ^ key.at(static_cast<int>((key_phase + i) % 8)));
+    }
+}
+
+// Ключ, которым файл с фазы 0 XOR-ится так же, как исходным ключом
+// с фазы key_phase: файловые пути всегда начинают с начала файла.
+QByteArray RotatedKey(const QByteArray& key, int key_phase) {
+    return key.mid(key_phase) + key.left(key_phase);
+}
+
+// Распаковывает кадр кодеком без XOR; false — кадр не читается.
+bool DecodeFrame(const QByteArray& frame, QByteArray* out) {
+    StreamCodec codec;
+    return codec.BeginDecompress(StreamCodec::DetectCodec(frame.constData(), frame.size())) &&
+           codec.Update(frame.constData(), frame.size(), out) &&
+           codec.Finish(out);
+}
+
+QByteArray RandomBytes(std::mt19937& random, qint64 size) {
+    QByteArray data(static_cast<int>(size), Qt::Uninitialized);
+    char* bytes = data.data();
+    for (qint64 i = 0; i < size; ++i) {
+        bytes[i] = static_cast<char>(random());
+    }
+    return data;
+}
+
+bool WriteFile(const QString& path, const QByteArray& data) {
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+QByteArray ReadFile(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+// Пустая строка, если данные совпали.
+QString Mismatch(const char* actual, qint64 actual_size, const QByteArray& expected) {
+    if (actual_size != expected.size()) {
+        return QString("размер %1 вместо %2").arg(actual_size).arg(expected.size());
+    }
+    for (qint64 i = 0; i < actual_size; ++i) {
+        if (actual[i] != expected.at(static_cast<int>(i))) {
+            return QString("первое расхождение в байте %1").arg(i);
+        }
+    }
+    return QString();
+}
+}  // namespace
+
+SelfCheck::SelfCheck(const QString& baseline_path) {
+    if (baseline_path.isEmpty()) {
+        return;
+    }
+    const QJsonObject object = QJsonDocument::fromJson(ReadFile(baseline_path)).object();
+    for (auto it = object.constBegin(); it != object.constEnd(); ++it) {
+        const double bytes_per_sec = it.value().toDouble();
+        if (bytes_per_sec > 0) {
+            baseline_.insert(it.key(), bytes_per_sec);
+        }
+    }
+}
+
+SelfCheck::Report SelfCheck::Run(quint32 seed) {
+    TRACE_SCOPE("SelfCheck::Run");
+    Report report;
+    QTemporaryDir temp_dir;
+    if (!temp_dir.isValid()) {
+        report.failures.append("Не удалось создать временную папку");
+        return report;
+    }
+
+    std::mt19937 random(seed);
+    const QByteArray key = RandomBytes(random, 8);
+    CheckKernel(random, key, &report);
+    CheckFileEngines(random, key, temp_dir.path(), &report);
+    MeasureThroughput(random, key, temp_dir.path(), &report);
+    return report;
+}
+
+void SelfCheck::CheckKernel(std::mt19937& random, const QByteArray& key, Report* report) {
+    for (int i = 0; i < kKernelCases; ++i) {
+        // Сначала все размеры до 64 байт подряд: хвосты короче слова и
+        // границы между ними, затем случайные.
+        const qint64 size = i < 64 ? i : static_cast<qint64>(random() % kMaxKernelCaseBytes);
+        const int alignment = static_cast<int>(random() % kGuardBytes);
+        const qint64 key_phase = static_cast<qint64>(random()) << 8 | (random() & 0xFF);
+
+        const QByteArray input = RandomBytes(random, alignment + size + kGuardBytes);
+        QByteArray actual = input;
+        QByteArray expected = input;
+        FileProcessor::XorChunk(actual.data() + alignment, size, key, key_phase);
+        ReferenceXor(expected.data() + alignment, size, key, key_phase);
+
+        const QString mismatch = Mismatch(actual.constData(), actual.size(), expected);
+        if (!mismatch.isEmpty()) {
+            AddFailure(report, kKernelEngine,
+                       QString("размер %1, выравнивание %2, фаза %3: %4")
+                           .arg(size).arg(alignment).arg(key_phase).arg(mismatch));
+            return;
+        }
+    }
+}
+
+void SelfCheck::CheckFileEngines(std::mt19937& random, const QByteArray& key,
+                                 const QString& directory, Report* report) {
+    const qint64 chunk = FileProcessor::kChunkSizeBytes;
+    QVector<qint64> sizes = {0, 1, 7, 8, 9, 4095, 4096, 4097,
+                             chunk - 1, chunk, chunk + 1, 3 * chunk + 5};
+    for (int i = 0; i < kRandomFileCases; ++i) {
+        sizes.append(static_cast<qint64>(random() % (4 * chunk)));
+    }
+
+    const QDir dir(directory);
+    const StreamCodec::Codec codec = StreamCodec::BuiltinCodec();
+    FileProcessor processor;
+    PackedContainerWriter container;
+    const QString container_path = dir.filePath("check.bopk");
+    if (!container.Open(container_path)) {
+        AddFailure(report, kContainerEngine, "не удалось создать контейнер");
+    }
+    QVector<QByteArray> container_expected;
+
+    for (int i = 0; i < sizes.size(); ++i) {
+        const qint64 size = sizes.at(i);
+        const QString case_name = QString("файл %1 байт").arg(size);
+        const QString input_path = dir.filePath(QString("in_%1").arg(i));
+        const QByteArray input = RandomBytes(random, size);
+        if (!WriteFile(input_path, input)) {
+            AddFailure(report, kProcessFileEngine, case_name + ": не удалось записать вход");
+            continue;
+        }
+        // Фаза ключа меняется от случая к случаю, чтобы ошибка в
+        // порядке байт ключа не совпала с эталоном на фазе 0.
+        const int key_phase = i % 8;
+        const QByteArray case_key = RotatedKey(key, key_phase);
+        QByteArray expected = input;
+        ReferenceXor(expected.data(), expected.size(), key, key_phase);
+
+        const QString file_output = dir.filePath(QString("out_%1").arg(i));
+        QString mismatch = processor.ProcessFile(input_path, file_output, case_key)
+            ? Mismatch(ReadFile(file_output).constData(), QFileInfo(file_output).size(), expected)
+            : QString("обработка не удалась");
+        if (!mismatch.isEmpty()) {
+            AddFailure(report, kProcessFileEngine, case_name + ": " + mismatch);
+        }
+
+        const QString small_output = dir.filePath(QString("small_%1").arg(i));
+        const FileProcessor::SmallFileResult small_result =
+            processor.ProcessSmallFile(input_path, small_output, case_key, kSmallFileLimit);
+        if (size > kSmallFileLimit) {
+            if (small_result != FileProcessor::SmallFileResult::kTooLarge ||
+                QFileInfo::exists(small_output)) {
+                AddFailure(report, kSmallFileEngine, case_name + ": большой файл не отклонён");
+            }
+        } else {
+            mismatch = small_result == FileProcessor::SmallFileResult::kDone
+                ? Mismatch(ReadFile(small_output).constData(), QFileInfo(small_output).size(), expected)
+                : QString("обработка не удалась");
+            if (!mismatch.isEmpty()) {
+                AddFailure(report, kSmallFileEngine, case_name + ": " + mismatch);
+            }
+        }
+
+        if (container.isOpen()) {
+            if (processor.ProcessFileToContainer(input_path, &container,
+                                                 QString("entry_%1").arg(i), case_key)) {
+                container_expected.append(expected);
+            } else {
+                AddFailure(report, kContainerEngine, case_name + ": запись не удалась");
+            }
+        }
+
+        if (codec != StreamCodec::Codec::kNone) {
+            // Сжатый выход, распакованный кодеком без ключа, должен
+            // совпасть с эталоном: иначе пропуск XOR в обе стороны
+            // прошёл бы проверку туда-обратно.
+            const QString compressed = dir.filePath(QString("packed_%1").arg(i));
+            QByteArray decoded;
+            if (!processor.CompressFile(input_path, compressed, case_key, codec)) {
+                mismatch = QString("сжатие не удалось");
+            } else if (!DecodeFrame(ReadFile(compressed), &decoded)) {
+                mismatch = QString("выход не читается кодеком");
+            } else {
+                mismatch = Mismatch(decoded.constData(), decoded.size(), expected);
+            }
+            if (!mismatch.isEmpty()) {
+                AddFailure(report, kCodecEngine, case_name + ": сжатие: " + mismatch);
+            }
+
+            const QString restored = dir.filePath(QString("restored_%1").arg(i));
+            mismatch = processor.DecompressFile(compressed, restored, case_key)
+                ? Mismatch(ReadFile(restored).constData(), QFileInfo(restored).size(), input)
+                : QString("распаковка не удалась");
+            if (!mismatch.isEmpty()) {
+                AddFailure(report, kCodecEngine, case_name + ": распаковка: " + mismatch);
+            }
+        }
+    }
+
+    if (!container.isOpen()) {
+        return;
+    }
+    PackedContainerReader reader;
+    if (!container.Finish() || !reader.Open(container_path)) {
+        AddFailure(report, kContainerEngine, "контейнер не читается: " + reader.error_string());
+        return;
+    }
+    for (int i = 0; i < reader.entries().size() && i < container_expected.size(); ++i) {
+        const QString mismatch = reader.Verify(i)
+            ? Mismatch(reader.EntryData(i), reader.entries().at(i).size, container_expected.at(i))
+            : QString("не сходится CRC");
+        if (!mismatch.isEmpty()) {
+            AddFailure(report, kContainerEngine,
+                       QString("запись %1: %2").arg(i).arg(mismatch));
+        }
+    }
+}
+
+void SelfCheck::MeasureThroughput(std::mt19937& random, const QByteArray& key,
+                                  const QString& directory, Report* report) {
+    // Входы замеров после прогрева лежат в кэше страниц, так что
+    // меряется обработка, а не диск, и повторы сравнимы между собой.
+    const QDir dir(directory);
+    QByteArray data = RandomBytes(random, kBenchmarkBytes);
+
+    Measure(report, kReferenceEngine, data.size(), [&data, &key]() {
+        ReferenceXor(data.data(), data.size(), key, 0);
+        return true;
+    });
+    Measure(report, kKernelEngine, data.size(), [&data, &key]() {
+        FileProcessor::XorChunk(data.data(), data.size(), key, 0);
+        return true;
+    });
+
+    const QString input_path = dir.filePath("benchmark_in");
+    if (!WriteFile(input_path, data)) {
+        report->failures.append("Не удалось записать файл для замера скорости");
+        return;
+    }
+    data.clear();
+
+    FileProcessor processor;
+    const QString output_path = dir.filePath("benchmark_out");
+    Measure(report, kProcessFileEngine, kBenchmarkBytes, [&]() {
+        return processor.ProcessFile(input_path, output_path, key);
+    });
+
+    const QString container_path = dir.filePath("benchmark.bopk");
+    Measure(report, kContainerEngine, kBenchmarkBytes, [&]() {
+        QFile::remove(container_path);
+        PackedContainerWriter container;
+        return container.Open(container_path) &&
+               processor.ProcessFileToContainer(input_path, &container, "benchmark", key) &&
+               container.Finish();
+    });
+
+    const StreamCodec::Codec codec = StreamCodec::BuiltinCodec();
+    if (codec != StreamCodec::Codec::kNone) {
+        const QString packed_path = dir.filePath("benchmark_packed");
+        Measure(report, kCodecEngine, kBenchmarkBytes, [&]() {
+            return processor.CompressFile(input_path, packed_path, key, codec);
+        });
+    }
+
+    QStringList small_inputs;
+    for (int i = 0; i < kSmallBenchmarkFiles; ++i) {
+        const QString path = dir.filePath(QString("benchmark_small_%1").arg(i));
+        if (WriteFile(path, RandomBytes(random, kSmallBenchmarkFileBytes))) {
+            small_inputs.append(path);
+        }
+    }
+    Measure(report, kSmallFileEngine, small_inputs.size() * kSmallBenchmarkFileBytes, [&]() {
+        for (const QString& path : small_inputs) {
+            if (processor.ProcessSmallFile(path, path + "_out", key, kSmallFileLimit) !=
+                FileProcessor::SmallFileResult::kDone) {
+                return false;
+            }
+        }
+        return true;
+    });
+
+    // Ядро не должно уступать побайтовому эталону.
+    const double reference_rate = FindEngine(report, kReferenceEngine)->bytes_per_sec;
+    EngineResult* kernel = FindEngine(report, kKernelEngine);
+    if (kernel->bytes_per_sec < reference_rate * (1.0 - kRegressionThreshold)) {
+        kernel->regressed = true;
+        report->failures.append(QString("%1 медленнее эталона: %2 против %3 МБ/с")
+                                    .arg(kernel->name)
+                                    .arg(kernel->bytes_per_sec / kBytesPerMb, 0, 'f', 0)
+                                    .arg(reference_rate / kBytesPerMb, 0, 'f', 0));
+    }
+}
+
+bool SelfCheck::Measure(Report* report, const QString& engine, qint64 bytes,
+                        const std::function<bool()>& run) {
+    if (!run()) {
+        AddFailure(report, engine, "замер скорости не удался");
+        return false;
+    }
+    QVector<qint64> samples;
+    samples.reserve(repetitions_);
+    QElapsedTimer timer;
+    for (int i = 0; i < repetitions_; ++i) {
+        timer.start();
+        if (!run()) {
+            AddFailure(report, engine, "замер скорости не удался");
+            return false;
+        }
+        samples.append(timer.nsecsElapsed());
+    }
+    std::sort(samples.begin(), samples.end());
+    AddThroughput(report, engine, bytes, samples.at(samples.size() / 2));
+    return true;
+}
+
+SelfCheck::EngineResult* SelfCheck::FindEngine(Report* report, const QString& engine) {
+    for (EngineResult& result : report->engines) {
+        if (result.name == engine) {
+            return &result;
+        }
+    }
+    report->engines.append(EngineResult());
+    report->engines.last().name = engine;
+    return &report->engines.last();
+}
+
+void SelfCheck::AddFailure(Report* report, const QString& engine, const QString& message) {
+    FindEngine(report, engine)->correct = false;
+    report->failures.append(engine + ": " + message);
+}
+
+void SelfCheck::AddThroughput(Report* report, const QString& engine, qint64 bytes,
+                              qint64 elapsed_ns) {
+    EngineResult* result = FindEngine(report, engine);
+    result->bytes_per_sec = bytes * 1e9 / qMax<qint64>(1, elapsed_ns);
+    result->baseline_bytes_per_sec = baseline_.value(engine, 0);
+    if (result->baseline_bytes_per_sec > 0 &&
+        result->bytes_per_sec < result->baseline_bytes_per_sec * (1.0 - kRegressionThreshold)) {
+        result->regressed = true;
+        report->failures.append(QString("%1 медленнее базы: %2 против %3 МБ/с")
+                                    .arg(engine)
+                                    .arg(result->bytes_per_sec / kBytesPerMb, 0, 'f', 0)
+                                    .arg(result->baseline_bytes_per_sec / kBytesPerMb, 0, 'f', 0));
+    }
+}
+
+bool SelfCheck::SaveBaseline(const Report& report, const QString& path) {
+    QJsonObject object;
+    for (const EngineResult& engine : report.engines) {
+        if (engine.bytes_per_sec > 0) {
+            object.insert(engine.name, engine.bytes_per_sec);
+        }
+    }
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    return file.open(QIODevice::WriteOnly) &&
+           file.write(QJsonDocument(object).toJson()) > 0 && file.commit();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QtGlobal>
+
+#include <functional>
+#include <random>
+
+// Сверяет все пути обработки (XorChunk, ProcessFile, ProcessSmallFile,
+// контейнер, сжатие) с побайтовым эталоном XOR на случайных размерах,
+// выравниваниях и фазах ключа и замеряет их скорость. Скорости
+// сравниваются с эталоном и с базой из baseline_path, если она задана.
+class SelfCheck {
+public:
+    // Путь считается медленным, если он медленнее эталона или базы
+    // больше чем на эту долю.
+    static constexpr double kRegressionThreshold = 0.2;
+    // Скорость — медиана стольких замеров после прогрева.
+    static constexpr int kDefaultRepetitions = 5;
+
+    struct EngineResult {
+        QString name;
+        bool correct = true;
+        double bytes_per_sec = 0;
+        // 0 — базы для пути ещё нет.
+        double baseline_bytes_per_sec = 0;
+        bool regressed = false;
+    };
+
+    struct Report {
+        QVector<EngineResult> engines;
+        // Расхождения и замедления, по одному на строку.
+        QStringList failures;
+
+        bool passed() const { return failures.isEmpty(); }
+    };
+
+    // Пустой baseline_path — сравнение только с эталоном.
+    explicit SelfCheck(const QString& baseline_path = QString());
+
+    bool has_baseline() const { return !baseline_.isEmpty(); }
+    void SetRepetitions(int repetitions) { repetitions_ = qMax(1, repetitions); }
+
+    // Работает во временной папке; seed задаёт случайные случаи.
+    Report Run(quint32 seed);
+    // Запоминает скорости отчёта в path как базу для следующих запусков.
+    static bool SaveBaseline(const Report& report, const QString& path);
+
+private:
+    void CheckKernel(std::mt19937& random, const QByteArray& key, Report* report);
+    void CheckFileEngines(std::mt19937& random, const QByteArray& key,
+                          const QString& directory, Report* report);
+    void MeasureThroughput(std::mt19937& random, const QByteArray& key,
+                           const QString& directory, Report* report);
+    static EngineResult* FindEngine(Report* report, const QString& engine);
+    void AddFailure(Report* report, const QString& engine, const QString& message);
+    // Прогоняет run один раз вхолостую и repetitions_ раз с замером и
+    // записывает скорость по медиане; false, если прогон не удался.
+    bool Measure(Report* report, const QString& engine, qint64 bytes,
+                 const std::function<bool()>& run);
+    void AddThroughput(Report* report, const QString& engine, qint64 bytes,
+                       qint64 elapsed_ns);
+
+    QHash<QString, double> baseline_;
+    int repetitions_ = kDefaultRepetitions;
+};
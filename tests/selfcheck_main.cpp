@@ -0,0 +1,83 @@
+#include "selfcheck.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QTextStream>
+
+namespace {
+constexpr double kBytesPerMb = 1024 * 1024;
+// Постоянный seed по умолчанию: падение в CI воспроизводится тем же
+// запуском без поиска seed в журнале.
+constexpr quint32 kDefaultSeed = 1;
+}
+
+// Возвращает 0, если все пути совпали с эталоном и не замедлились.
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Сверка путей обработки с эталонным XOR и замер их скорости");
+    parser.addHelpOption();
+    const QCommandLineOption seed_option(
+        "seed", "Начальное значение для случайных случаев.", "seed",
+        QString::number(kDefaultSeed));
+    const QCommandLineOption random_seed_option(
+        "random-seed", "Взять seed из текущего времени вместо --seed.");
+    const QCommandLineOption baseline_option(
+        "baseline", "Файл с базовыми скоростями; без него скорости сравниваются только с эталоном.",
+        "path");
+    const QCommandLineOption update_baseline_option(
+        "update-baseline", "Записать скорости успешного прогона в файл --baseline.");
+    const QCommandLineOption repetitions_option(
+        "repetitions", "Число замеров скорости каждого пути, берётся медиана.", "count",
+        QString::number(SelfCheck::kDefaultRepetitions));
+    parser.addOptions({seed_option, random_seed_option, baseline_option,
+                       update_baseline_option, repetitions_option});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    const QString baseline_path = parser.value(baseline_option);
+    const bool update_baseline = parser.isSet(update_baseline_option);
+    if (update_baseline && baseline_path.isEmpty()) {
+        out << "--update-baseline требует --baseline\n";
+        return 2;
+    }
+    const quint32 seed = parser.isSet(random_seed_option)
+        ? static_cast<quint32>(QDateTime::currentMSecsSinceEpoch())
+        : parser.value(seed_option).toUInt();
+
+    // При обновлении старая база не сравнивается: её как раз заменяют.
+    SelfCheck self_check(update_baseline ? QString() : baseline_path);
+    self_check.SetRepetitions(parser.value(repetitions_option).toInt());
+    const SelfCheck::Report report = self_check.Run(seed);
+
+    for (const SelfCheck::EngineResult& engine : report.engines) {
+        out << QString("%1: %2 МБ/с")
+                   .arg(engine.name)
+                   .arg(engine.bytes_per_sec / kBytesPerMb, 0, 'f', 0);
+        if (engine.baseline_bytes_per_sec > 0) {
+            out << QString(" (база %1 МБ/с)")
+                       .arg(engine.baseline_bytes_per_sec / kBytesPerMb, 0, 'f', 0);
+        }
+        out << '\n';
+    }
+    for (const QString& failure : report.failures) {
+        out << "ОШИБКА: " << failure << '\n';
+    }
+    if (!report.passed()) {
+        out << QString("Самопроверка НЕ пройдена (seed %1)\n").arg(seed);
+        return 1;
+    }
+
+    if (update_baseline) {
+        if (!SelfCheck::SaveBaseline(report, baseline_path)) {
+            out << "Не удалось сохранить базу: " << baseline_path << '\n';
+            return 1;
+        }
+        out << "Базовые скорости сохранены: " << baseline_path << '\n';
+    }
+    out << QString("Самопроверка пройдена (seed %1)\n").arg(seed);
+    return 0;
+}
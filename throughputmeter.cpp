@@ -0,0 +1,45 @@
+#include "throughputmeter.h"
+
+namespace {
+constexpr qint64 kMinSpanMs = 1000;
+}
+
+ThroughputMeter::ThroughputMeter(qint64 window_ms)
+    : window_ms_(window_ms) {
+    Reset();
+}
+
+void ThroughputMeter::Reset() {
+    clock_.start();
+    samples_.clear();
+    total_bytes_ = 0;
+    samples_.enqueue({0, 0});
+}
+
+void ThroughputMeter::Add(qint64 bytes) {
+    const qint64 now_ms = clock_.elapsed();
+    total_bytes_ += bytes;
+    samples_.enqueue({now_ms, total_bytes_});
+    Trim(now_ms);
+}
+
+double ThroughputMeter::bytes_per_sec() {
+    const qint64 now_ms = clock_.elapsed();
+    Trim(now_ms);
+    const qint64 span_ms = now_ms - samples_.head().first;
+    if (span_ms < kMinSpanMs) {
+        return 0.0;
+    }
+    const double rate = (total_bytes_ - samples_.head().second) * 1000.0 / span_ms;
+    if (rate > 0) {
+        last_bytes_per_sec_ = rate;
+    }
+    return rate;
+}
+
+void ThroughputMeter::Trim(qint64 now_ms) {
+    // Последний замер старше окна остаётся началом отсчёта.
+    while (samples_.size() > 1 && now_ms - samples_.at(1).first >= window_ms_) {
+        samples_.dequeue();
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QPair>
+#include <QQueue>
+#include <QtGlobal>
+
+// Скорость обработки по скользящему окну: байты, пришедшие за последние
+// window_ms, делённые на прошедшее время.
+class ThroughputMeter {
+public:
+    explicit ThroughputMeter(qint64 window_ms = 10000);
+
+    // Начинает новый замер; последняя измеренная скорость сохраняется.
+    void Reset();
+    void Add(qint64 bytes);
+
+    // Байт в секунду за окно; 0, пока замер короче секунды.
+    double bytes_per_sec();
+    // Последняя ненулевая скорость, в том числе прошлых запусков.
+    double last_bytes_per_sec() const { return last_bytes_per_sec_; }
+
+private:
+    void Trim(qint64 now_ms);
+
+    qint64 window_ms_;
+    QElapsedTimer clock_;
+    // Моменты прихода данных и суммарный объём к этим моментам.
+    QQueue<QPair<qint64, qint64>> samples_;
+    qint64 total_bytes_ = 0;
+    double last_bytes_per_sec_ = 0.0;
+};
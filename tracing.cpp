@@ -0,0 +1,183 @@
+#include "tracing.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// Кольца завершившихся потоков хранятся для выгрузки трассы, но не
+// больше стольких: остановка создаёт новые потоки воркеров.
+constexpr int kMaxExitedRings = 16;
+
+// Слот кольца под seqlock: sequence нечётна, пока владелец пишет
+// событие номер n, и равна 2n + 2 после записи. Читатель берёт слот,
+// только если sequence до и после копирования совпадает с ожидаемой.
+struct TraceEvent {
+    std::atomic<quint64> sequence{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<qint64> start_ns{0};
+    std::atomic<qint64> duration_ns{0};
+};
+
+struct ThreadRing {
+    int thread_index = 0;
+    QString thread_name;
+    // Пишет только поток-владелец; читатель берёт head с acquire и
+    // последние kRingCapacity событий.
+    std::atomic<quint64> head{0};
+    std::atomic<bool> exited{false};
+    TraceEvent events[Tracer::kRingCapacity];
+};
+
+QMutex& RegistryMutex() {
+    static QMutex mutex;
+    return mutex;
+}
+
+std::vector<std::unique_ptr<ThreadRing>>& Registry() {
+    static std::vector<std::unique_ptr<ThreadRing>> rings;
+    return rings;
+}
+
+// Вызывается под RegistryMutex; удаляет самые старые кольца
+// завершившихся потоков сверх kMaxExitedRings.
+void ReclaimExitedRings() {
+    std::vector<std::unique_ptr<ThreadRing>>& rings = Registry();
+    int exited = 0;
+    for (const std::unique_ptr<ThreadRing>& ring : rings) {
+        exited += ring->exited.load(std::memory_order_acquire) ? 1 : 0;
+    }
+    for (auto it = rings.begin(); it != rings.end() && exited > kMaxExitedRings;) {
+        if ((*it)->exited.load(std::memory_order_acquire)) {
+            it = rings.erase(it);
+            --exited;
+        } else {
+            ++it;
+        }
+    }
+}
+
+ThreadRing* RegisterCurrentThread() {
+    static int next_thread_index = 1;
+    auto ring = std::make_unique<ThreadRing>();
+    QThread* thread = QThread::currentThread();
+    QMutexLocker locker(&RegistryMutex());
+    ReclaimExitedRings();
+    ring->thread_index = next_thread_index++;
+    ring->thread_name = thread && !thread->objectName().isEmpty()
+                            ? thread->objectName()
+                            : QString("Поток %1").arg(ring->thread_index);
+    Registry().push_back(std::move(ring));
+    return Registry().back().get();
+}
+
+// Отмечает кольцо при выходе потока; удаляет его следующая регистрация.
+struct RingOwner {
+    ThreadRing* ring = RegisterCurrentThread();
+    ~RingOwner() { ring->exited.store(true, std::memory_order_release); }
+};
+
+ThreadRing* CurrentRing() {
+    thread_local RingOwner owner;
+    return owner.ring;
+}
+
+QByteArray JsonEscaped(const QString& text) {
+    QByteArray escaped;
+    for (const QChar ch : text) {
+        if (ch == '"' || ch == '\\') {
+            escaped.append('\\');
+        }
+        escaped.append(QString(ch).toUtf8());
+    }
+    return escaped;
+}
+
+}  // namespace
+
+qint64 Tracer::NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void Tracer::Record(const char* name, qint64 start_ns, qint64 end_ns) {
+    ThreadRing* ring = CurrentRing();
+    const quint64 head = ring->head.load(std::memory_order_relaxed);
+    TraceEvent& event = ring->events[head % kRingCapacity];
+    event.sequence.store(2 * head + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name.store(name, std::memory_order_relaxed);
+    event.start_ns.store(start_ns, std::memory_order_relaxed);
+    event.duration_ns.store(end_ns - start_ns, std::memory_order_relaxed);
+    event.sequence.store(2 * head + 2, std::memory_order_release);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+bool Tracer::WriteChromeTrace(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    QByteArray out = "{\"traceEvents\":[\n";
+    bool ok = true;
+    bool first = true;
+    auto append_event = [&out, &first](const QByteArray& json) {
+        if (!first) {
+            out.append(",\n");
+        }
+        first = false;
+        out.append(json);
+    };
+
+    QMutexLocker locker(&RegistryMutex());
+    for (const std::unique_ptr<ThreadRing>& ring : Registry()) {
+        append_event(QString("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                             "\"tid\":%1,\"args\":{\"name\":\"%2\"}}")
+                         .arg(ring->thread_index)
+                         .arg(QString::fromUtf8(JsonEscaped(ring->thread_name)))
+                         .toUtf8());
+
+        const quint64 head = ring->head.load(std::memory_order_acquire);
+        const quint64 begin =
+            head > static_cast<quint64>(kRingCapacity) ? head - kRingCapacity : 0;
+        for (quint64 i = begin; i < head; ++i) {
+            const TraceEvent& event = ring->events[i % kRingCapacity];
+            // Пока шла выгрузка, владелец мог обогнать читателя на круг:
+            // такой слот уже содержит другое событие или пишется сейчас.
+            const quint64 sequence = event.sequence.load(std::memory_order_acquire);
+            if (sequence != 2 * i + 2) {
+                continue;
+            }
+            const char* name = event.name.load(std::memory_order_relaxed);
+            const qint64 start_ns = event.start_ns.load(std::memory_order_relaxed);
+            const qint64 duration_ns = event.duration_ns.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (event.sequence.load(std::memory_order_relaxed) != sequence) {
+                continue;
+            }
+            append_event(QString("{\"name\":\"%1\",\"ph\":\"X\",\"pid\":1,"
+                                 "\"tid\":%2,\"ts\":%3,\"dur\":%4}")
+                             .arg(QLatin1String(name))
+                             .arg(ring->thread_index)
+                             .arg(start_ns / 1000.0, 0, 'f', 3)
+                             .arg(duration_ns / 1000.0, 0, 'f', 3)
+                             .toUtf8());
+        }
+
+        if (out.size() > (1 << 20)) {
+            ok = file.write(out) == out.size() && ok;
+            out.clear();
+        }
+    }
+    out.append("\n]}\n");
+
+    return file.write(out) == out.size() && ok;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+
+// Лёгкие трассировочные интервалы. Собираются только с
+// BINOPS_ENABLE_TRACING, иначе TRACE_SCOPE ничего не делает.
+// Каждый поток пишет в свой кольцевой буфер без блокировок;
+// WriteChromeTrace выгружает их в формате Chrome/Perfetto trace JSON.
+class Tracer {
+public:
+#if defined(BINOPS_ENABLE_TRACING)
+    static constexpr bool kEnabled = true;
+#else
+    static constexpr bool kEnabled = false;
+#endif
+    static constexpr int kRingCapacity = 1 << 16;
+
+    static qint64 NowNs();
+    // name должен жить до конца программы (строковый литерал).
+    static void Record(const char* name, qint64 start_ns, qint64 end_ns);
+    static bool WriteChromeTrace(const QString& path);
+};
+
+#if defined(BINOPS_ENABLE_TRACING)
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name)
+        : name_(name), start_ns_(Tracer::NowNs()) {}
+    ~TraceSpan() { Tracer::Record(name_, start_ns_, Tracer::NowNs()); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name_;
+    qint64 start_ns_;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) do {} while (false)
+#endif
@@ -1,49 +1,129 @@
 #include "worker.h"
 
+#include "cpuaffinity.h"
 #include "filemanager.h"
+#include "filesync.h"
+#include "packedcontainer.h"
+#include "readahead.h"
+#include "tracing.h"
 
-#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QThread>
 
+namespace {
+// Быстрый путь не шлёт пофайловых сообщений; вместо них — сводка
+// раз в столько файлов.
+constexpr int kFastPathReportInterval = 1000;
+constexpr int kMaxContainerNameAttempts = 1000;
+constexpr qint64 kBytesReportInterval = 4 * 1024 * 1024;
+}
+
 Worker::Worker(FileManager* file_manager,
                Settings settings,
+               BufferPool* buffer_pool,
+               IoThrottle* io_throttle,
+               DedupCache* dedup_cache,
                QObject* parent)
     : QObject(parent),
     file_manager_(file_manager),
-    settings_(std::move(settings)) {}
+    settings_(std::move(settings)),
+    processor_(buffer_pool),
+    io_throttle_(io_throttle),
+    dedup_cache_(dedup_cache) {
+    processor_.SetIoThrottle(io_throttle);
+}
 
 Worker::~Worker() {
     RequestCancel();
-    QCoreApplication::processEvents();
 }
 
-
 void Worker::RequestCancel() {
     cancel_requested_.storeRelaxed(1);
 }
 
-void Worker::SetFilesToProcess(const QStringList& paths) {
+void Worker::SetSettings(const Settings& settings) {
+    settings_ = settings;
+}
+
+void Worker::SetFileManager(FileManager* file_manager) {
+    file_manager_ = file_manager;
+}
+
+void Worker::SetDedupCache(DedupCache* dedup_cache) {
+    dedup_cache_ = dedup_cache;
+}
+
+void Worker::SetFilesToProcess(const QStringList& paths,
+                               const QVector<qint64>& sizes) {
     files_to_process_ = paths;
+    file_sizes_ = sizes;
+}
+
+void Worker::SetCodecThreads(int threads) {
+    processor_.SetCodecThreads(threads);
+}
+
+void Worker::BindToCpus(const QVector<int>& cpus) {
+    if (!CpuAffinity::PinCurrentThread(cpus)) {
+        emit ErrorOccurred(tr("Не удалось привязать воркер к процессорам"));
+        processor_.SetNumaNode(-1);
+        return;
+    }
+    processor_.SetNumaNode(CpuAffinity::NumaNodeOfCpus(cpus));
+}
+
+void Worker::MarkBusy() {
+    QMutexLocker locker(&state_mutex_);
+    busy_ = true;
+    cancel_requested_.storeRelaxed(0);
+}
+
+bool Worker::IsBusy() const {
+    QMutexLocker locker(&state_mutex_);
+    return busy_;
+}
+
+bool Worker::WaitForIdle(unsigned long timeout_ms) {
+    QMutexLocker locker(&state_mutex_);
+    if (busy_) {
+        idle_condition_.wait(&state_mutex_, timeout_ms);
+    }
+    return !busy_;
 }
 
 void Worker::Process() {
+    TRACE_SCOPE("Worker::Process");
+    processed_files_ = 0;
+    unreported_bytes_ = 0;
+    ProcessFiles();
+    files_to_process_.clear();
+    file_sizes_.clear();
+    FlushReportedBytes();
+
+    {
+        QMutexLocker locker(&state_mutex_);
+        busy_ = false;
+        idle_condition_.wakeAll();
+    }
+    emit Finished(processed_files_);
+}
+
+void Worker::ProcessFiles() {
     if (!file_manager_->IsValid()) {
         emit ErrorOccurred("Не заданы входная папка или маска файлов.");
-        emit Finished();
         return;
     }
 
     if (settings_.xor_key_8_bytes().size() != 8) {
         emit ErrorOccurred("Ключ XOR должен быть ровно 8 байт (16 hex-символов).");
-        emit Finished();
         return;
     }
 
     if (settings_.output_directory().isEmpty()) {
         emit ErrorOccurred("Не указана выходная папка.");
-        emit Finished();
         return;
     }
 
@@ -52,7 +132,11 @@ void Worker::Process() {
                                     : files_to_process_;
     if (input_paths.isEmpty()) {
         emit StatusMessage("Нет файлов для обработки.");
-        emit Finished();
+        return;
+    }
+
+    if (settings_.output_format() == Settings::OutputFormat::kContainer) {
+        ProcessFilesToContainer(input_paths);
         return;
     }
 
@@ -64,51 +148,341 @@ void Worker::Process() {
             ? FileManager::OutputPathMode::kOverwrite
             : FileManager::OutputPathMode::kAppendCounter;
 
-    FileProcessor processor;
-    int processed = 0;
+    const Settings::Compression compression = settings_.compression();
+    const StreamCodec::Codec codec = StreamCodec::BuiltinCodec();
+    if (compression != Settings::Compression::kOff && codec == StreamCodec::Codec::kNone) {
+        emit ErrorOccurred("Программа собрана без поддержки сжатия (zstd или LZ4).");
+        return;
+    }
+    // Быстрый путь пишет вход как есть, без кодека.
+    const qint64 fast_path_limit = compression == Settings::Compression::kOff
+        ? settings_.small_file_fast_path_bytes()
+        : 0;
+    const bool dedup_enabled =
+        dedup_cache_ && settings_.dedup_mode() != Settings::DedupMode::kOff;
+    processor_.SetInputHash(dedup_enabled ? &input_hash_ : nullptr);
 
+    int deduplicated = 0;
+    int fast_since_report = 0;
+    GroupCommit group_commit(settings_.durability(),
+                             settings_.group_commit_max_files(),
+                             settings_.group_commit_interval_ms());
+    auto commit_completed = [&]() {
+        QStringList committed_inputs;
+        if (!group_commit.Flush(&committed_inputs)) {
+            emit ErrorOccurred(
+                tr("Не удалось сбросить выходные файлы на диск, входные файлы не удалены"));
+            return false;
+        }
+        if (settings_.persistent_queue()) {
+            if (!committed_inputs.isEmpty()) {
+                emit FilesCommitted(committed_inputs, delete_input);
+            }
+        } else if (delete_input) {
+            for (const QString& input_path : committed_inputs) {
+                QFile::remove(input_path);
+            }
+        }
+        return true;
+    };
+    auto complete_file = [&](const QString& input_path, const QString& output_path) {
+        ++processed_files_;
+        group_commit.Add(input_path, output_path);
+        return !group_commit.IsDue() || commit_completed();
+    };
+    auto report_failure = [this](const QString& input_path) {
+        if (cancel_requested_.loadRelaxed()) {
+            emit StatusMessage("Остановлено пользователем.");
+        } else {
+            emit ErrorOccurred(
+                tr("Ошибка обработки файла: %1").arg(input_path));
+        }
+    };
+
+    // Размеры из очереди, если она их передала; без них подсказки не
+    // отличают малые файлы.
+    const QVector<qint64> known_sizes =
+        file_sizes_.size() == input_paths.size() ? file_sizes_ : QVector<qint64>();
+    ReadAhead read_ahead(settings_.prefetch_files(), settings_.prefetch_budget_bytes());
+    read_ahead.SetFiles(input_paths, known_sizes, fast_path_limit);
+
+    QStringList name_sources;
+    name_sources.reserve(input_paths.size());
     for (const QString& input_path : input_paths) {
+        name_sources.append(OutputNameSource(input_path, compression, codec));
+    }
+    const QStringList output_paths = file_manager_->GetOutputPathsFor(
+        name_sources, settings_.output_directory(), path_mode);
+
+    for (int index = 0; index < input_paths.size(); ++index) {
+        const QString& input_path = input_paths.at(index);
         if (cancel_requested_.loadRelaxed()) {
+            commit_completed();
             emit StatusMessage("Остановлено пользователем.");
-            emit Finished();
             return;
         }
+        read_ahead.Advance(index);
 
-        QString output_path = file_manager_->GetOutputPathFor(
-            input_path, settings_.output_directory(), path_mode);
+        const QString& output_path = output_paths.at(index);
 
-        QFileInfo input_info(input_path);
-        emit StatusMessage(
-            tr("Обработка: %1").arg(input_info.fileName()));
+        const qint64 input_size = InputSize(index, input_path);
+        // Часть файла, уже учтённая в BytesProcessed.
+        qint64 reported_bytes = 0;
+        if (dedup_enabled) {
+            if (TryDeduplicate(input_path, input_size, output_path)) {
+                ++deduplicated;
+                ReportBytes(input_size);
+                if (!complete_file(input_path, output_path)) {
+                    return;
+                }
+                continue;
+            }
+            input_hash_.reset();
+        }
 
-        bool ok = processor.ProcessFile(
-            input_path, output_path, xor_key,
-            [this, &input_info](int percent) {
+        bool done = false;
+        // Размер уже известен: крупный файл не открывается лишний раз.
+        // kTooLarge остаётся на случай, если файл вырос после снимка.
+        if (fast_path_limit > 0 && input_size <= fast_path_limit) {
+            const FileProcessor::SmallFileResult result =
+                processor_.ProcessSmallFile(
+                    input_path, output_path, xor_key, fast_path_limit,
+                    [this]() { return cancel_requested_.loadRelaxed() != 0; });
+            if (result == FileProcessor::SmallFileResult::kFailed) {
+                commit_completed();
+                report_failure(input_path);
+                return;
+            }
+            if (result == FileProcessor::SmallFileResult::kDone) {
+                done = true;
+                if (++fast_since_report >= kFastPathReportInterval) {
+                    fast_since_report = 0;
+                    emit StatusMessage(tr("Обработано файлов: %1 из %2")
+                                           .arg(processed_files_ + 1)
+                                           .arg(total_files));
+                }
+            }
+        }
+
+        if (!done) {
+            QFileInfo input_info(input_path);
+            emit StatusMessage(
+                tr("Обработка: %1").arg(input_info.fileName()));
+
+            auto progress = [this, &input_info, input_size, &reported_bytes](int percent) {
                 emit ProgressFile(input_info.fileName(), percent);
-            },
-            [this]() {
-                QCoreApplication::processEvents();
-                return cancel_requested_.loadRelaxed() != 0;
-            });
+                const qint64 done_bytes = input_size * percent / 100;
+                ReportBytes(done_bytes - reported_bytes);
+                reported_bytes = done_bytes;
+            };
+            auto is_cancelled = [this]() { return cancel_requested_.loadRelaxed() != 0; };
+            bool ok = false;
+            bool not_compressed = false;
+            switch (compression) {
+            case Settings::Compression::kCompress:
+                ok = processor_.CompressFile(input_path, output_path, xor_key, codec,
+                                             progress, is_cancelled);
+                break;
+            case Settings::Compression::kDecompress:
+                ok = processor_.DecompressFile(input_path, output_path, xor_key,
+                                               progress, is_cancelled, &not_compressed);
+                break;
+            case Settings::Compression::kOff:
+                ok = processor_.ProcessFile(input_path, output_path, xor_key,
+                                            progress, is_cancelled);
+                break;
+            }
+            if (!ok && not_compressed && !cancel_requested_.loadRelaxed()) {
+                // Чужой файл в папке не должен останавливать весь пакет.
+                emit ErrorOccurred(
+                    tr("Вход не сжат поддерживаемым кодеком, пропущен: %1").arg(input_path));
+                ReportBytes(input_size - reported_bytes);
+                ++processed_files_;
+                continue;
+            }
+            if (!ok) {
+                commit_completed();
+                report_failure(input_path);
+                return;
+            }
+        }
+
+        ReportBytes(input_size - reported_bytes);
+        if (dedup_enabled) {
+            // Без кодека выход того же размера, что и вход.
+            const qint64 output_size = compression == Settings::Compression::kOff
+                ? input_size
+                : QFileInfo(output_path).size();
+            dedup_cache_->Insert(input_size, input_hash_.result(), output_path,
+                                 output_size);
+        }
+        if (!complete_file(input_path, output_path)) {
+            return;
+        }
+    }
+
+    if (!commit_completed()) {
+        return;
+    }
+
+    if (deduplicated > 0) {
+        emit StatusMessage(tr("Дубликатов без повторной обработки: %1").arg(deduplicated));
+    }
+    emit StatusMessage(tr("Готово. Обработано файлов: %1").arg(processed_files_));
+}
+
+bool Worker::TryDeduplicate(const QString& input_path, qint64 input_size,
+                            const QString& output_path) {
+    if (!dedup_cache_->HasSize(input_size)) {
+        return false;
+    }
+
+    const QByteArray fingerprint = DedupCache::Fingerprint(
+        input_path, io_throttle_,
+        [this]() { return cancel_requested_.loadRelaxed() != 0; });
+    if (fingerprint.isEmpty()) {
+        return false;
+    }
+    qint64 source_size = 0;
+    const QString source_path = dedup_cache_->Find(input_size, fingerprint, &source_size);
+    if (source_path.isEmpty() || source_path == output_path) {
+        return false;
+    }
+
+    QFileInfo source_info(source_path);
+    if (!source_info.exists() || source_info.size() != source_size) {
+        dedup_cache_->Remove(input_size, fingerprint);
+        return false;
+    }
+
+    return DedupCache::Materialize(source_path, output_path,
+                                   settings_.dedup_mode(),
+                                   settings_.dedup_copy_fallback());
+}
+
+void Worker::ProcessFilesToContainer(const QStringList& input_paths) {
+    const QDir out_dir(settings_.output_directory());
+    const QString base_name = QString("batch_%1").arg(
+        QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss"));
+
+    PackedContainerWriter container;
+    for (int attempt = 0; attempt < kMaxContainerNameAttempts; ++attempt) {
+        const QString name = attempt == 0
+            ? base_name + ".bopk"
+            : QString("%1_%2.bopk").arg(base_name).arg(attempt);
+        if (container.Open(out_dir.absoluteFilePath(name))) {
+            break;
+        }
+    }
+    if (!container.isOpen()) {
+        emit ErrorOccurred(tr("Не удалось создать контейнер в %1")
+                               .arg(settings_.output_directory()));
+        return;
+    }
+
+    const int total_files = input_paths.size();
+    const QByteArray xor_key = settings_.xor_key_8_bytes();
+    QStringList packed_inputs;
+
+    ReadAhead read_ahead(settings_.prefetch_files(), settings_.prefetch_budget_bytes());
+    read_ahead.SetFiles(input_paths);
+
+    for (int index = 0; index < input_paths.size(); ++index) {
+        const QString& input_path = input_paths.at(index);
+        if (cancel_requested_.loadRelaxed()) {
+            container.Discard();
+            emit StatusMessage("Остановлено пользователем.");
+            return;
+        }
+        read_ahead.Advance(index);
+
+        const bool ok = processor_.ProcessFileToContainer(
+            input_path, &container, QFileInfo(input_path).fileName(), xor_key,
+            [this]() { return cancel_requested_.loadRelaxed() != 0; });
         if (!ok) {
             if (cancel_requested_.loadRelaxed()) {
+                container.Discard();
                 emit StatusMessage("Остановлено пользователем.");
-            } else {
-                emit ErrorOccurred(
-                    tr("Ошибка обработки файла: %1").arg(input_path));
+                return;
             }
-            emit Finished();
-            return;
+            emit ErrorOccurred(tr("Ошибка обработки файла: %1").arg(input_path));
+            break;
+        }
+
+        packed_inputs.append(input_path);
+        ReportBytes(InputSize(index, input_path));
+        if (packed_inputs.size() % kFastPathReportInterval == 0) {
+            emit StatusMessage(tr("Упаковано файлов: %1 из %2")
+                                   .arg(packed_inputs.size())
+                                   .arg(total_files));
         }
-        ++processed;
-        emit ProgressOverall(static_cast<int>((100 * processed) / total_files));
+    }
 
-        if (delete_input) {
+    const QString container_path = container.path();
+    if (!container.Finish()) {
+        emit ErrorOccurred(tr("Не удалось записать индекс контейнера: %1").arg(container_path));
+        return;
+    }
+
+    if (settings_.durability() != Settings::Durability::kNone &&
+        (!FileSync::SyncFile(container_path) ||
+         !FileSync::SyncDirectory(QFileInfo(container_path).absolutePath()))) {
+        emit ErrorOccurred(
+            tr("Не удалось сбросить контейнер на диск, входные файлы не удалены: %1")
+                .arg(container_path));
+        return;
+    }
+
+    // Входы удаляются только после записи индекса: до этого контейнер
+    // нельзя прочитать.
+    processed_files_ = packed_inputs.size();
+    if (settings_.persistent_queue()) {
+        emit FilesCommitted(packed_inputs, settings_.delete_input_files());
+    } else if (settings_.delete_input_files()) {
+        for (const QString& input_path : packed_inputs) {
             QFile::remove(input_path);
         }
     }
 
-    emit StatusMessage(tr("Готово. Обработано файлов: %1").arg(processed));
-    emit ProgressOverall(100);
-    emit Finished();
+    emit StatusMessage(tr("Контейнер записан: %1 (файлов: %2)")
+                           .arg(container_path)
+                           .arg(packed_inputs.size()));
+}
+
+QString Worker::OutputNameSource(const QString& input_path,
+                                 Settings::Compression compression,
+                                 StreamCodec::Codec codec) {
+    if (compression == Settings::Compression::kCompress) {
+        return input_path + StreamCodec::FileSuffix(codec);
+    }
+    if (compression == Settings::Compression::kDecompress) {
+        for (StreamCodec::Codec known : {StreamCodec::Codec::kZstd, StreamCodec::Codec::kLz4}) {
+            const QString suffix = StreamCodec::FileSuffix(known);
+            if (input_path.endsWith(suffix, Qt::CaseInsensitive)) {
+                return input_path.chopped(suffix.size());
+            }
+        }
+    }
+    return input_path;
+}
+
+qint64 Worker::InputSize(int index, const QString& input_path) const {
+    if (file_sizes_.size() == files_to_process_.size() && index < file_sizes_.size()) {
+        return file_sizes_.at(index);
+    }
+    return QFileInfo(input_path).size();
+}
+
+void Worker::ReportBytes(qint64 bytes) {
+    unreported_bytes_ += bytes;
+    if (unreported_bytes_ >= kBytesReportInterval) {
+        FlushReportedBytes();
+    }
+}
+
+void Worker::FlushReportedBytes() {
+    if (unreported_bytes_ > 0) {
+        emit BytesProcessed(unreported_bytes_);
+    }
+    unreported_bytes_ = 0;
 }
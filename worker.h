@@ -1,14 +1,21 @@
 #pragma once
 
+#include <QCryptographicHash>
+#include <QMutex>
 #include <QObject>
 #include <QStringList>
+#include <QVector>
+#include <QWaitCondition>
 #include <QtGlobal>
 #include <memory>
 
+#include "dedupcache.h"
 #include "fileprocessor.h"
 #include "settings.h"
 
+class BufferPool;
 class FileManager;
+class IoThrottle;
 
 class Worker : public QObject {
     Q_OBJECT
@@ -16,25 +23,82 @@ class Worker : public QObject {
 public:
     explicit Worker(FileManager* file_manager,
                     Settings settings,
+                    BufferPool* buffer_pool,
+                    IoThrottle* io_throttle,
+                    DedupCache* dedup_cache,
                     QObject* parent = nullptr);
     ~Worker() override;
 
-    void SetFilesToProcess(const QStringList& paths);
+    void SetSettings(const Settings& settings);
+    // Задание пакета: его FileManager и кэш дубликатов.
+    void SetFileManager(FileManager* file_manager);
+    void SetDedupCache(DedupCache* dedup_cache);
+    // sizes — размеры файлов из очереди планировщика; без них воркер
+    // узнаёт размер каждого файла сам.
+    void SetFilesToProcess(const QStringList& paths,
+                           const QVector<qint64>& sizes = QVector<qint64>());
+    // Потоки кодека на файл; планировщик делит ядра между воркерами.
+    void SetCodecThreads(int threads);
     void Process();
 
+    // Вызывается в потоке воркера: привязывает поток к cpus и выделяет
+    // дальнейшие буферы на их узле NUMA.
+    void BindToCpus(const QVector<int>& cpus);
+
+    // Вызываются из потока планировщика перед постановкой пакета в очередь
+    // потока воркера и при ожидании его завершения.
+    void MarkBusy();
+    bool IsBusy() const;
+    bool WaitForIdle(unsigned long timeout_ms);
+
 public slots:
     void RequestCancel();
 
 signals:
-    void ProgressOverall(int percent);
+    // Входные байты, обработанные с прошлого уведомления; отправляются
+    // порциями, последняя — до Finished.
+    void BytesProcessed(qint64 bytes);
     void ProgressFile(const QString& file_name, int percent);
     void StatusMessage(const QString& message);
-    void Finished();
+    // processed_files — сколько первых файлов пакета пройдено: обработано
+    // или пропущено с сообщением об ошибке.
+    void Finished(int processed_files);
+    // Входы, выходы которых записаны и сброшены на диск; только при
+    // включённом persistent_queue. Удалять входы (remove_inputs) должен
+    // получатель после записи в журнал очереди: иначе сбой между
+    // удалением и записью оставил бы в журнале несуществующие файлы.
+    void FilesCommitted(const QStringList& input_paths, bool remove_inputs);
     void ErrorOccurred(const QString& message);
 
 private:
+    void ProcessFiles();
+    void ProcessFilesToContainer(const QStringList& input_paths);
+    // Создаёт output_path из уже обработанного идентичного файла.
+    bool TryDeduplicate(const QString& input_path, qint64 input_size,
+                        const QString& output_path);
+    // Путь, по имени которого строится имя выхода: с расширением кодека
+    // при сжатии и без него при распаковке.
+    static QString OutputNameSource(const QString& input_path,
+                                    Settings::Compression compression,
+                                    StreamCodec::Codec codec);
+    // Размер index-го файла пакета: из очереди, если она его передала.
+    qint64 InputSize(int index, const QString& input_path) const;
+    void ReportBytes(qint64 bytes);
+    void FlushReportedBytes();
+
     FileManager* file_manager_;
     Settings settings_;
     QStringList files_to_process_;
+    QVector<qint64> file_sizes_;
+    FileProcessor processor_;
+    IoThrottle* io_throttle_;
+    DedupCache* dedup_cache_;
+    QCryptographicHash input_hash_{DedupCache::kHashAlgorithm};
     QAtomicInt cancel_requested_{0};
+    int processed_files_ = 0;
+    qint64 unreported_bytes_ = 0;
+
+    mutable QMutex state_mutex_;
+    QWaitCondition idle_condition_;
+    bool busy_ = false;
 };